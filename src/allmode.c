@@ -0,0 +1,604 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2020 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Evaluate the calendars of all users on a pool of threads in a single
+ * process ('calendar -a -j threads'), instead of forking a child for
+ * each user.
+ *
+ * The files of a user are read by a helper child running with the
+ * credentials of the user, which sends the contents back over a socket,
+ * so the calendar files (and the files they include) are only read with
+ * the permissions of the user.  The socket is polled with the deadline
+ * of the user, and the helper is killed if it blocks (e.g., on a stalled
+ * network file system) past it, as the fork mode kills its child.  The
+ * world-readable system calendar files are read once and shared by all
+ * the users, and so are their parsed entries (see struct cal_cache),
+ * which are only parsed again for the users that reach them in a
+ * different state (e.g., with another 'LANG' or definitions).
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <pwd.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calendar.h"
+#include "allmode.h"
+#include "dates.h"
+#include "io.h"
+#include "utils.h"
+
+#define MAX_THREADS	64
+#define HELPER_CHUNK	(16 * 1024)  /* file data per message */
+#define HELPER_MAXSIZE	(16 * 1024 * 1024)  /* maximum size of a file */
+
+/* types of the messages from the helper, followed by the data */
+#define HELPER_DATA	'D'
+#define HELPER_END	'E'
+#define HELPER_FAIL	'F'
+
+/* calendar evaluation of a user */
+struct job {
+	struct job	*next;
+	char		*user;
+	uid_t		 uid;
+	gid_t		 gid;
+	gid_t		*groups;  /* supplementary groups */
+	int		 ngroups;
+	pid_t		 helper;  /* helper child reading the files */
+	int		 sock;  /* socket to the helper */
+	bool		 killed;  /* whether the helper timed out */
+	time_t		 deadline;  /* time to give up the user */
+	char		**bufs;  /* contents of the files read */
+	int		 nbufs;
+	FILE		*fp;  /* calendar file of the user */
+};
+
+/* queue of the jobs, consumed by the worker threads */
+static struct {
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 cond;
+	struct job	*head;
+	struct job	*tail;
+	int		 njobs;
+	int		 maxjobs;
+	bool		 done;  /* whether all jobs have been added */
+} queue = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* system calendar file shared by the users */
+struct sysfile {
+	char		*path;
+	char		*data;  /* NULL if the file cannot be shared */
+	size_t		 len;
+};
+
+static struct sysfile *sysfiles = NULL;
+static int nsysfiles = 0;
+static int maxsysfiles = 0;
+static pthread_mutex_t sysfiles_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct cal_cache *cache = NULL;  /* parsed system files */
+
+static pthread_t workers[MAX_THREADS];
+static int nworkers = 0;
+static int user_timeout = 0;
+
+static void	helper_main(int sock, uid_t uid, gid_t gid,
+			    const gid_t *groups, int ngroups) __dead2;
+static void	helper_send(int sock, int fd);
+static FILE	*helper_open(struct job *job, const char *path);
+static void	job_free(struct job *job);
+static bool	is_sysfile(const char *path);
+static FILE	*sysfile_open(const char *path);
+static bool	sysfile_shared(const char *path);
+static FILE	*open_file(const char *path, void *arg);
+static void	*worker(void *arg);
+
+
+/*
+ * Main loop of the helper child: read the requested files with the
+ * credentials of the user and send back the contents.  Only the
+ * async-signal-safe functions are used, since the parent is threaded.
+ */
+static void
+helper_main(int sock, uid_t uid, gid_t gid, const gid_t *groups, int ngroups)
+{
+	char path[PATH_MAX];
+	struct stat sb;
+	ssize_t n;
+	int fd;
+
+	/*
+	 * Do not hold the files and helper sockets of the other users, which
+	 * the threads may have open at the fork.
+	 */
+	if (sock != 3) {
+		if (dup2(sock, 3) == -1)
+			_exit(1);
+		sock = 3;
+	}
+	closefrom(4);
+
+	if (setgroups((size_t)ngroups, groups) == -1 ||
+	    setgid(gid) == -1 || setuid(uid) == -1)
+		_exit(1);
+
+	for (;;) {
+		n = recv(sock, path, sizeof(path) - 1, 0);
+		if (n <= 0)
+			_exit(0);
+		path[n] = '\0';
+
+		/* only regular files, and do not block on FIFOs */
+		fd = open(path, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+		if (fd != -1 &&
+		    (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode) ||
+		     fcntl(fd, F_SETFL, 0) == -1)) {
+			close(fd);
+			fd = -1;
+		}
+
+		helper_send(sock, fd);
+		if (fd != -1)
+			close(fd);
+	}
+}
+
+/*
+ * Send the contents of the file $fd (-1 for failure) over the socket, in
+ * messages of HELPER_DATA and a final HELPER_END (or HELPER_FAIL).
+ */
+static void
+helper_send(int sock, int fd)
+{
+	static char buf[1 + HELPER_CHUNK];
+	ssize_t n;
+
+	if (fd != -1) {
+		buf[0] = HELPER_DATA;
+		while ((n = read(fd, buf + 1, HELPER_CHUNK)) > 0) {
+			if (send(sock, buf, (size_t)n + 1, MSG_NOSIGNAL) == -1)
+				_exit(1);
+		}
+		buf[0] = (n == 0) ? HELPER_END : HELPER_FAIL;
+	} else {
+		buf[0] = HELPER_FAIL;
+	}
+
+	if (send(sock, buf, 1, MSG_NOSIGNAL) == -1)
+		_exit(1);
+}
+
+/*
+ * Read the file $path by the helper of the job, waiting until the
+ * deadline of the job.  The helper is killed on timeout or any other
+ * error than failing to open the file.  The contents are kept with the
+ * job.  Return NULL on failure.
+ */
+static FILE *
+helper_open(struct job *job, const char *path)
+{
+	static __thread char buf[1 + HELPER_CHUNK];
+	struct pollfd pfd = { .fd = job->sock, .events = POLLIN };
+	char *data = NULL;
+	size_t len = 0;
+	ssize_t n;
+	time_t left;
+	int ret;
+
+	if (job->killed)
+		return NULL;
+	if (send(job->sock, path, strlen(path),
+		 MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+		return NULL;
+
+	for (;;) {
+		left = job->deadline - time(NULL);
+		if (left <= 0) {
+			ret = 0;
+		} else {
+			ret = poll(&pfd, 1, (int)left * 1000);
+			if (ret == -1 && errno == EINTR)
+				continue;
+		}
+		if (ret == 0) {
+			warnx("timed out reading calendar of user %s: '%s'",
+			      job->user, path);
+			break;
+		}
+		if (ret == -1 || (n = recv(job->sock, buf, sizeof(buf), 0)) <= 0)
+			break;
+		if (buf[0] == HELPER_FAIL) {
+			free(data);
+			return NULL;  /* the helper is ready for the next */
+		}
+
+		if (buf[0] == HELPER_DATA) {
+			if (len + (size_t)n > HELPER_MAXSIZE) {
+				warnx("calendar file of user %s too large: "
+				      "'%s'", job->user, path);
+				break;
+			}
+			data = xrealloc(data, len + (size_t)n - 1);
+			memcpy(data + len, buf + 1, (size_t)n - 1);
+			len += (size_t)n - 1;
+			continue;
+		}
+		if (buf[0] != HELPER_END)
+			break;
+
+		/* an empty line for an empty file, which fmemopen() rejects */
+		if (len == 0) {
+			data = xstrdup("\n");
+			len = 1;
+		}
+		job->bufs = xrealloc(job->bufs, (size_t)(job->nbufs + 1) *
+				     sizeof(*job->bufs));
+		job->bufs[job->nbufs++] = data;
+		return fmemopen(data, len, "r");
+	}
+
+	/* the rest of the file may follow; give up the helper */
+	kill(job->helper, SIGKILL);
+	job->killed = true;
+	free(data);
+	return NULL;
+}
+
+static void
+job_free(struct job *job)
+{
+	if (job->fp != NULL)
+		fclose(job->fp);
+	close(job->sock);  /* the helper exits */
+	if (job->killed) {
+		/* may be stuck in the kernel; do not wait for it */
+		waitpid(job->helper, NULL, WNOHANG);
+	} else {
+		while (waitpid(job->helper, NULL, 0) == -1 && errno == EINTR)
+			;
+	}
+	for (int i = 0; i < job->nbufs; i++)
+		free(job->bufs[i]);
+	free(job->bufs);
+	free(job->groups);
+	free(job->user);
+	free(job);
+}
+
+/*
+ * Whether $path is a file in the system calendar directories, i.e., not
+ * in the calendar home of the user and without '..' components.
+ */
+static bool
+is_sysfile(const char *path)
+{
+	const char *p;
+	size_t len;
+	bool found = false;
+
+	for (size_t i = 0; calendarDirs[i] != NULL; i++) {
+		if (calendarDirs[i][0] != '/')
+			continue;
+		len = strlen(calendarDirs[i]);
+		if (strncmp(path, calendarDirs[i], len) == 0 &&
+		    path[len] == '/') {
+			found = true;
+			break;
+		}
+	}
+	if (!found)
+		return false;
+
+	for (p = path; (p = strstr(p, "..")) != NULL; p += 2) {
+		if ((p == path || p[-1] == '/') && (p[2] == '/' || p[2] == '\0'))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Open the shared copy of the system calendar file $path, which is read
+ * on the first use.  Return NULL if it does not exist.
+ */
+static FILE *
+sysfile_open(const char *path)
+{
+	struct sysfile *sf = NULL;
+	struct stat sb;
+	FILE *fp;
+	size_t cap;
+
+	pthread_mutex_lock(&sysfiles_lock);
+	for (int i = 0; i < nsysfiles; i++) {
+		if (strcmp(sysfiles[i].path, path) == 0) {
+			sf = &sysfiles[i];
+			break;
+		}
+	}
+	if (sf == NULL) {
+		if (nsysfiles == maxsysfiles) {
+			maxsysfiles = (maxsysfiles > 0) ? 2 * maxsysfiles : 32;
+			sysfiles = xrealloc(sysfiles, (size_t)maxsysfiles *
+					    sizeof(*sysfiles));
+		}
+		sf = &sysfiles[nsysfiles++];
+		memset(sf, 0, sizeof(*sf));
+		sf->path = xstrdup(path);
+
+		/* only share the files that every user can read */
+		if ((fp = fopen(path, "re")) != NULL) {
+			if (fstat(fileno(fp), &sb) == 0 &&
+			    S_ISREG(sb.st_mode) && (sb.st_mode & S_IROTH)) {
+				cap = (size_t)sb.st_size + 1;
+				sf->data = xcalloc(1, cap);
+				sf->len = fread(sf->data, 1, cap - 1, fp);
+			}
+			fclose(fp);
+		}
+	}
+	pthread_mutex_unlock(&sysfiles_lock);
+
+	if (sf->data == NULL || sf->len == 0)
+		return NULL;
+	return fmemopen(sf->data, sf->len, "r");
+}
+
+/*
+ * Whether the file $path is a system calendar file shared by the users,
+ * whose parsed entries can then be shared too.
+ */
+static bool
+sysfile_shared(const char *path)
+{
+	bool shared = false;
+
+	if (!is_sysfile(path))
+		return false;
+
+	pthread_mutex_lock(&sysfiles_lock);
+	for (int i = 0; i < nsysfiles; i++) {
+		if (strcmp(sysfiles[i].path, path) == 0) {
+			shared = (sysfiles[i].data != NULL &&
+				  sysfiles[i].len > 0);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sysfiles_lock);
+
+	return shared;
+}
+
+/*
+ * Hook of the context to open the calendar files of the job.
+ */
+static FILE *
+open_file(const char *path, void *arg)
+{
+	struct job *job = arg;
+	FILE *fp;
+
+	if (is_sysfile(path) && (fp = sysfile_open(path)) != NULL)
+		return fp;
+
+	return helper_open(job, path);
+}
+
+static void *
+worker(void *arg __unused)
+{
+	struct cal_context *ctx, *prev;
+	struct job *job;
+
+	ctx = cal_context_new();
+	ctx->open_file = open_file;
+	ctx->cache = cache;
+
+	for (;;) {
+		pthread_mutex_lock(&queue.lock);
+		while (queue.head == NULL && !queue.done)
+			pthread_cond_wait(&queue.cond, &queue.lock);
+		if ((job = queue.head) != NULL) {
+			if ((queue.head = job->next) == NULL)
+				queue.tail = NULL;
+			queue.njobs--;
+			pthread_cond_broadcast(&queue.cond);
+		}
+		pthread_mutex_unlock(&queue.lock);
+		if (job == NULL)
+			break;
+
+		ctx->open_arg = job;
+		ctx->mail_user = job->user;
+		ctx->mail_uid = job->uid;
+		ctx->mail_gid = job->gid;
+		ctx->mail_groups = job->groups;
+		ctx->mail_ngroups = job->ngroups;
+		ctx->deadline = job->deadline = time(NULL) + user_timeout;
+
+		prev = cal_context_set(ctx);
+		generate_dates();
+		if (cal(job->fp) != 0) {
+			warnx("failed to process calendar of user %s",
+			      job->user);
+		}
+		free_dates();
+		cal_reset();
+		cal_context_set(prev);
+
+		job_free(job);
+	}
+
+	cal_context_free(ctx);
+	return NULL;
+}
+
+/*
+ * Start $nthreads worker threads, which give up a user after $timeout
+ * seconds.
+ */
+void
+allmode_start(int nthreads, int timeout)
+{
+	if (nthreads > MAX_THREADS)
+		nthreads = MAX_THREADS;
+	user_timeout = timeout;
+	queue.maxjobs = 2 * nthreads;
+	cache = cal_cache_new(sysfile_shared);
+
+	for (nworkers = 0; nworkers < nthreads; nworkers++) {
+		if (pthread_create(&workers[nworkers], NULL, worker,
+				   NULL) != 0) {
+			errx(1, "%s: pthread_create() failed", __func__);
+		}
+	}
+}
+
+/*
+ * Add the user $pw, whose calendar home is the current directory, to be
+ * evaluated with its calendar file $file.  Return false if the user has
+ * no such file.
+ */
+bool
+allmode_add(const struct passwd *pw, const char *file)
+{
+	struct job *job;
+	gid_t groups[NGROUPS_MAX + 1];
+	int ngroups = NGROUPS_MAX + 1;
+	int sv[2];
+
+	if (getgrouplist(pw->pw_name, pw->pw_gid, groups, &ngroups) == -1) {
+		warnx("too many groups of user %s", pw->pw_name);
+		return false;
+	}
+
+	/*
+	 * The descriptors of the jobs must not leak into the sendmail of
+	 * another user, which is executed by a worker thread.
+	 */
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+		warn("socketpair");
+		return false;
+	}
+
+	job = xcalloc(1, sizeof(*job));
+	job->user = xstrdup(pw->pw_name);
+	job->uid = pw->pw_uid;
+	job->gid = pw->pw_gid;
+	job->groups = xmalloc((size_t)ngroups * sizeof(*groups));
+	memcpy(job->groups, groups, (size_t)ngroups * sizeof(*groups));
+	job->ngroups = ngroups;
+	job->sock = sv[0];
+	job->deadline = time(NULL) + user_timeout;
+
+	/* the helper starts in the current directory, i.e., the home */
+	if ((job->helper = fork()) == -1) {
+		warn("fork");
+		close(sv[0]);
+		close(sv[1]);
+		free(job->groups);
+		free(job->user);
+		free(job);
+		return false;
+	}
+	if (job->helper == 0) {
+		helper_main(sv[1], pw->pw_uid, pw->pw_gid, groups, ngroups);
+	}
+	close(sv[1]);
+
+	if ((job->fp = helper_open(job, file)) == NULL) {
+		job_free(job);
+		return false;
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	while (queue.njobs >= queue.maxjobs)
+		pthread_cond_wait(&queue.cond, &queue.lock);
+	if (queue.tail != NULL)
+		queue.tail->next = job;
+	else
+		queue.head = job;
+	queue.tail = job;
+	queue.njobs++;
+	pthread_cond_broadcast(&queue.cond);
+	pthread_mutex_unlock(&queue.lock);
+
+	return true;
+}
+
+/*
+ * Wait for the workers to finish all the added users.
+ */
+void
+allmode_finish(void)
+{
+	pthread_mutex_lock(&queue.lock);
+	queue.done = true;
+	pthread_cond_broadcast(&queue.cond);
+	pthread_mutex_unlock(&queue.lock);
+
+	for (int i = 0; i < nworkers; i++)
+		pthread_join(workers[i], NULL);
+	nworkers = 0;
+
+	cal_cache_free(cache);
+	cache = NULL;
+	for (int i = 0; i < nsysfiles; i++) {
+		free(sysfiles[i].path);
+		free(sysfiles[i].data);
+	}
+	free(sysfiles);
+	sysfiles = NULL;
+	nsysfiles = maxsysfiles = 0;
+}
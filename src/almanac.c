@@ -0,0 +1,316 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2019 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Almanac of the Sun and Moon for a range of days, with the days
+ * partitioned by month across threads.
+ */
+
+#include <err.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "almanac.h"
+#include "basics.h"
+#include "chinese.h"
+#include "gregorian.h"
+#include "moon.h"
+#include "sun.h"
+#include "utils.h"
+
+/* lunar phase and lunar crossings of a day */
+struct almanac_day {
+	double	moonrise;	/* first moonrise; NaN if not happen */
+	double	moonset;	/* first moonset; NaN if not happen */
+	double	phase;		/* lunar phase at noon */
+};
+
+/* principal moon phase or solar term */
+struct almanac_event {
+	double		t;	/* moment in standard time */
+	const char	*name;
+	const char	*zhname;  /* NULL for moon phases */
+};
+
+struct almanac_job {
+	const struct location	*loc;
+	int			rd_begin;
+	const int		*months;  /* first day of each month */
+	int			nmonths;
+	struct almanac_day	*days;
+	int			first;	/* first month of this thread */
+	int			stride;	/* number of threads */
+};
+
+static void *
+almanac_worker(void *arg)
+{
+	const struct almanac_job *job = arg;
+	struct lunar_crossing crossings[MOON_CROSSINGS_MAX];
+	struct almanac_day *ad;
+	int n;
+
+	for (int m = job->first; m < job->nmonths; m += job->stride) {
+		for (int rd = job->months[m]; rd < job->months[m+1]; rd++) {
+			ad = &job->days[rd - job->rd_begin];
+			ad->moonrise = ad->moonset = NAN;
+			ad->phase = lunar_phase(rd + 0.5 - job->loc->zone);
+
+			n = lunar_crossings(rd, job->loc, crossings,
+					    MOON_CROSSINGS_MAX);
+			for (int i = n - 1; i >= 0; i--) {
+				if (crossings[i].rising)
+					ad->moonrise = crossings[i].t;
+				else
+					ad->moonset = crossings[i].t;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Calculate the lunar phases and crossings of the days in the range
+ * [$rd_begin, $rd_end] at location $loc, with each month of days being
+ * a work item of the threads.
+ */
+static void
+almanac_days(int rd_begin, int rd_end, const struct location *loc,
+	     struct almanac_day *days)
+{
+	struct almanac_job *jobs;
+	struct date date;
+	pthread_t *threads;
+	long ncpu;
+	int *months;
+	int nmonths, nthreads;
+
+	months = xcalloc((size_t)(rd_end - rd_begin + 2), sizeof(*months));
+	nmonths = 0;
+	for (int rd = rd_begin; rd <= rd_end; rd++) {
+		gregorian_from_fixed(rd, &date);
+		if (rd == rd_begin || date.day == 1)
+			months[nmonths++] = rd;
+	}
+	months[nmonths] = rd_end + 1;
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = (ncpu > 1) ? (int)ncpu : 1;
+	if (nthreads > nmonths)
+		nthreads = nmonths;
+
+	jobs = xcalloc((size_t)nthreads, sizeof(*jobs));
+	threads = xcalloc((size_t)nthreads, sizeof(*threads));
+	for (int i = 0; i < nthreads; i++) {
+		jobs[i] = (struct almanac_job){
+			.loc = loc,
+			.rd_begin = rd_begin,
+			.months = months,
+			.nmonths = nmonths,
+			.days = days,
+			.first = i,
+			.stride = nthreads,
+		};
+		if (i == 0)
+			continue;  /* run by the calling thread */
+		if (pthread_create(&threads[i], NULL, almanac_worker,
+				   &jobs[i]) != 0) {
+			errx(1, "%s: pthread_create() failed", __func__);
+		}
+	}
+
+	almanac_worker(&jobs[0]);
+	for (int i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(jobs);
+	free(months);
+}
+
+static int
+almanac_event_cmp(const void *a, const void *b)
+{
+	const struct almanac_event *ea = a, *eb = b;
+
+	return (ea->t > eb->t) - (ea->t < eb->t);
+}
+
+/*
+ * Append an event to the array $*events of $*n items, growing the
+ * allocated $*nmax items as needed.
+ */
+static void
+almanac_event_add(struct almanac_event **events, int *n, int *nmax,
+		  double t, const char *name, const char *zhname)
+{
+	if (*n == *nmax) {
+		*nmax *= 2;
+		*events = xrealloc(*events, (size_t)*nmax * sizeof(**events));
+	}
+	(*events)[(*n)++] = (struct almanac_event){
+		.t = t,
+		.name = name,
+		.zhname = zhname,
+	};
+}
+
+/*
+ * Collect the principal moon phases and the solar terms happening in
+ * the range [$rd_begin, $rd_end] at location $loc, sorted by time.
+ * Return the number of events stored in $events.
+ */
+static int
+almanac_events(int rd_begin, int rd_end, const struct location *loc,
+	       struct almanac_event **events)
+{
+	static const char *phase_names[] = {
+		"New Moon", "First Quarter", "Full Moon", "Last Quarter",
+	};
+	const struct chinese_jieqi *jq;
+	struct almanac_event *ev;
+	double t_begin = rd_begin - loc->zone;
+	double t_end = rd_end + 1 - loc->zone;
+	double t_newmoon, t;
+	int n = 0;
+	/* 4 phases per lunation and 2 solar terms per month, with margins */
+	int nmax = (rd_end - rd_begin + 1) / 4 + 8;
+
+	ev = xcalloc((size_t)nmax, sizeof(*ev));
+
+	t_newmoon = new_moon_before(t_begin);
+	while (t_newmoon < t_end) {
+		t = t_newmoon;
+		for (int i = 0; i < 4; i++) {
+			if (i > 0)
+				t = lunar_phase_atafter(90.0 * i, t);
+			if (t >= t_begin && t < t_end) {
+				almanac_event_add(&ev, &n, &nmax,
+						  t + loc->zone,
+						  phase_names[i], NULL);
+			}
+		}
+		t_newmoon = new_moon_atafter(t_newmoon + 28);
+	}
+
+	t = t_begin;
+	while ((t = chinese_jieqi_atafter(t, &jq)) < t_end) {
+		almanac_event_add(&ev, &n, &nmax, t + loc->zone,
+				  jq->name, jq->zhname);
+		t += 10;  /* solar terms are about 15 days apart */
+	}
+
+	qsort(ev, (size_t)n, sizeof(*ev), almanac_event_cmp);
+	*events = ev;
+	return n;
+}
+
+/*
+ * Show the almanac of each day in the range [$rd_begin, $rd_end] at
+ * location $loc: sunrise, sunset, moonrise, moonset, lunar phase at
+ * noon, as well as the principal moon phases and solar terms.
+ */
+void
+show_almanac(int rd_begin, int rd_end, const struct location *loc)
+{
+	struct almanac_day *days, *ad;
+	struct almanac_event *events;
+	struct solar_day *suns, *sd;
+	struct date date;
+	char buf[64];
+	int ndays = rd_end - rd_begin + 1;
+	int nevents, iev;
+
+	if (ndays <= 0)
+		return;
+
+	/*
+	 * The timeline caches are per thread, so this only warms the calling
+	 * thread (which runs the first month below); each other worker
+	 * builds its own caches, reused within its months of days.
+	 */
+	nevents = almanac_events(rd_begin, rd_end, loc, &events);
+
+	suns = xcalloc((size_t)ndays, sizeof(*suns));
+	solar_days(rd_begin, ndays, loc, 1, suns);
+	days = xcalloc((size_t)ndays, sizeof(*days));
+	almanac_days(rd_begin, rd_end, loc, days);
+
+	printf("%-10s  %8s  %8s  %8s  %8s  %7s  %s\n",
+	       "Date", "Sunrise", "Sunset", "Moonrise", "Moonset",
+	       "Phase", "Events");
+
+	iev = 0;
+	for (int i = 0; i < ndays; i++) {
+		sd = &suns[i];
+		ad = &days[i];
+		double moments[] = {
+			sd->sunrise, sd->sunset, ad->moonrise, ad->moonset,
+		};
+
+		gregorian_from_fixed(rd_begin + i, &date);
+		printf("%d-%02d-%02d", date.year, date.month, date.day);
+		for (size_t k = 0; k < nitems(moments); k++) {
+			if (isnan(moments[k]))
+				snprintf(buf, sizeof(buf), "(null)");
+			else
+				format_time(buf, sizeof(buf), moments[k]);
+			printf("  %8s", buf);
+		}
+		printf("  %6.2f°", ad->phase);
+
+		for (bool first = true;
+		     iev < nevents && events[iev].t < rd_begin + i + 1;
+		     iev++, first = false) {
+			format_time(buf, sizeof(buf), events[iev].t);
+			printf("%s", first ? "  " : ", ");
+			if (events[iev].zhname)
+				printf("%s ", events[iev].zhname);
+			printf("%s %s", events[iev].name, buf);
+		}
+		printf("\n");
+	}
+
+	free(days);
+	free(suns);
+	free(events);
+}
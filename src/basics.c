@@ -112,15 +112,13 @@ nth_kday(int n, int dow, struct date *date)
 }
 
 /*
- * Calculate the ephemeris correction (fraction of day) required for
- * converting between Universal Time and Dynamical Time at moment $t.
+ * Calculate the ephemeris correction (fraction of day) for the Gregorian
+ * year $year.
  * Ref: Sec.(14.2), Eq.(14.15)
  */
-double
-ephemeris_correction(double t)
+static double
+ephemeris_correction_year(int year)
 {
-	int rd = (int)floor(t);
-	int year = gregorian_year_from_fixed(rd);
 	int y2000 = year - 2000;
 	int y1700 = year - 1700;
 	int y1600 = year - 1600;
@@ -174,6 +172,48 @@ ephemeris_correction(double t)
 	}
 }
 
+/* number of cached years */
+#define EPHEMERIS_CACHE_SIZE	4
+
+/*
+ * Calculate the ephemeris correction (fraction of day) required for
+ * converting between Universal Time and Dynamical Time at moment $t.
+ *
+ * The correction only depends on the year, so cache it (per thread)
+ * together with the range of fixed dates of the year.
+ */
+double
+ephemeris_correction(double t)
+{
+	static __thread struct {
+		int	rd_begin;	/* January 1 */
+		int	rd_end;		/* January 1 of the next year */
+		double	value;
+	} cache[EPHEMERIS_CACHE_SIZE];
+	static __thread int ncached = 0, next = 0;
+	struct date date;
+	int rd = (int)floor(t);
+	int year, i;
+
+	for (i = 0; i < ncached; i++) {
+		if (rd >= cache[i].rd_begin && rd < cache[i].rd_end)
+			return cache[i].value;
+	}
+
+	year = gregorian_year_from_fixed(rd);
+	i = next;
+	date_set(&date, year, 1, 1);
+	cache[i].rd_begin = fixed_from_gregorian(&date);
+	date_set(&date, year + 1, 1, 1);
+	cache[i].rd_end = fixed_from_gregorian(&date);
+	cache[i].value = ephemeris_correction_year(year);
+	next = (next + 1) % EPHEMERIS_CACHE_SIZE;
+	if (ncached < EPHEMERIS_CACHE_SIZE)
+		ncached++;
+
+	return cache[i].value;
+}
+
 /*
  * Convert from Universal Time (UT) to Dynamical Time (DT).
  * Ref: Sec.(14.2), Eq.(14.16)
@@ -203,8 +243,52 @@ double
 julian_centuries(double t)
 {
 	double dt = dynamical_from_universal(t);
-	double j2000 = 0.5 + gregorian_new_year(2000);
-	return (dt - j2000) / 36525.0;
+	return (dt - J2000) / 36525.0;
+}
+
+/*
+ * Evaluate the angular function of $ap at moment $t with the piecewise
+ * Chebyshev approximation, which is fitted for the segment containing
+ * $t on demand.  The segments are aligned to Gregorian years, because
+ * the ephemeris correction changes at the beginning of each year.
+ * Fall back to the exact function outside the covered years.
+ */
+double
+angular_approx_eval(struct angular_approx *ap, double t)
+{
+	struct chebyshev *cb;
+	struct date date;
+	double y_begin, y_end, length, a, b;
+	int year, i;
+
+	for (i = 0; i < ap->ncached; i++) {
+		cb = &ap->cache[i];
+		if (t >= cb->a && t < cb->b)
+			return mod_f(chebyshev_eval(cb, t), 360);
+	}
+
+	year = gregorian_year_from_fixed((int)floor(t));
+	if (year < APPROX_YEAR_BEGIN || year > APPROX_YEAR_END)
+		return ap->func(t);
+
+	date_set(&date, year, 1, 1);
+	y_begin = fixed_from_gregorian(&date);
+	date_set(&date, year + 1, 1, 1);
+	y_end = fixed_from_gregorian(&date);
+	length = (y_end - y_begin) / ap->nsegments;
+	i = (int)floor((t - y_begin) / length);
+	if (i >= ap->nsegments)
+		i = ap->nsegments - 1;
+	a = y_begin + i * length;
+	b = (i == ap->nsegments - 1) ? y_end : a + length;
+
+	cb = &ap->cache[ap->next];
+	chebyshev_fit_angular(cb, ap->func, a, b, ap->nnodes);
+	ap->next = (ap->next + 1) % APPROX_CACHE_SIZE;
+	if (ap->ncached < APPROX_CACHE_SIZE)
+		ap->ncached++;
+
+	return mod_f(chebyshev_eval(cb, t), 360);
 }
 
 /*
@@ -215,9 +299,8 @@ julian_centuries(double t)
 double
 sidereal_from_moment(double t)
 {
-	double j2000 = 0.5 + gregorian_new_year(2000);
 	int century_days = 36525;
-	double c = (t - j2000) / century_days;
+	double c = (t - J2000) / century_days;
 	double coef[] = { 280.46061837, 360.98564736629 * century_days,
 			  0.000387933, -1.0 / 38710000.0 };
 	return mod_f(poly(c, coef, nitems(coef)), 360);
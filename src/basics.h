@@ -39,6 +39,8 @@
 
 #include <stddef.h>
 
+#include "utils.h"
+
 struct date {
 	int	year;
 	int	month;
@@ -60,6 +62,34 @@ struct location {
 	double	zone;		/* time offset (in days) from UTC */
 };
 
+/*
+ * Moment of noon on January 1, 2000 (Gregorian), i.e., the fixed date
+ * of gregorian_new_year(2000) plus half a day.
+ * Ref: Sec.(14.2), Eq.(14.19)
+ */
+#define J2000		730120.5
+
+/* number of cached segments of an angular approximation */
+#define APPROX_CACHE_SIZE	4
+
+/*
+ * Piecewise Chebyshev approximation of an angular function of time (e.g.,
+ * solar longitude), fitted on demand from the exact function $func in
+ * segments aligned to Gregorian years, within years [APPROX_YEAR_BEGIN,
+ * APPROX_YEAR_END].
+ */
+#define APPROX_YEAR_BEGIN	1800
+#define APPROX_YEAR_END		2199
+
+struct angular_approx {
+	double	(*func)(double t);	/* exact function */
+	int	nsegments;		/* segments per year */
+	int	nnodes;			/* Chebyshev nodes per segment */
+	int	ncached;
+	int	next;
+	struct chebyshev cache[APPROX_CACHE_SIZE];
+};
+
 enum dayofweek {
 	SUNDAY = 0,
 	MONDAY,
@@ -80,6 +110,8 @@ int	dayofyear_from_fixed(int rd);
 double	julian_centuries(double t);
 double	sidereal_from_moment(double t);
 
+double	angular_approx_eval(struct angular_approx *ap, double t);
+
 double	ephemeris_correction(double t);
 double	universal_from_dynamical(double t);
 double	dynamical_from_universal(double t);
@@ -0,0 +1,168 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2020 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Batch mode: evaluate the calendar file for many windows of dates (e.g.,
+ * the reminders of every day of a month), printing each window as a
+ * separate section or file.
+ *
+ * The consecutive windows are grouped into spans of at most CAL_MAX_REPEAT
+ * days, and the calendar file is parsed only once for each group; the
+ * events of a window are then printed from the days of the group.  The
+ * span is limited because a date matches at most CAL_MAX_REPEAT days in
+ * a parse.
+ */
+
+#include <err.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "calendar.h"
+#include "basics.h"
+#include "batch.h"
+#include "dates.h"
+#include "gregorian.h"
+#include "io.h"
+
+static FILE	*window_open(const struct batch_window *window,
+			     const char *outdir);
+
+/*
+ * Open the output of the window: a file named after the date in
+ * $outdir, or stdout with a section header if $outdir is NULL.
+ */
+static FILE *
+window_open(const struct batch_window *window, const char *outdir)
+{
+	static const char *suffixes[] = {
+		[OUTPUT_TEXT] = "txt",
+		[OUTPUT_JSON] = "jsonl",
+		[OUTPUT_ICS] = "ics",
+	};
+	struct date date;
+	char path[PATH_MAX];
+	FILE *fp;
+
+	gregorian_from_fixed(window->today, &date);
+
+	if (outdir == NULL) {
+		/* JSON records carry their dates; ICS has a VCALENDAR each */
+		if (Options.output == OUTPUT_TEXT) {
+			printf("==> %04d-%02d-%02d <==\n",
+			       date.year, date.month, date.day);
+		}
+		return stdout;
+	}
+
+	snprintf(path, sizeof(path), "%s/%04d-%02d-%02d.%s", outdir,
+		 date.year, date.month, date.day, suffixes[Options.output]);
+	if ((fp = fopen(path, "w")) == NULL)
+		warn("Cannot create file: '%s'", path);
+
+	return fp;
+}
+
+/*
+ * Evaluate the calendar file $fp for the $nwindows windows, writing to
+ * the files in $outdir, or to stdout if $outdir is NULL.  The file must
+ * be seekable if more than one parse is needed.
+ */
+int
+batch_run(FILE *fp, const struct batch_window *windows, int nwindows,
+	  const char *outdir)
+{
+	const struct batch_window *w;
+	FILE *fpout;
+	int ret = 0;
+	int i, j, begin, end, nparses;
+
+	nparses = 0;
+	for (i = 0; i < nwindows; i = j) {
+		/* group the following windows within CAL_MAX_REPEAT days */
+		begin = windows[i].day_begin;
+		end = windows[i].day_end;
+		for (j = i + 1; j < nwindows; j++) {
+			w = &windows[j];
+			if (w->day_end - begin >= CAL_MAX_REPEAT ||
+			    end - w->day_begin >= CAL_MAX_REPEAT)
+				break;
+			if (w->day_begin < begin)
+				begin = w->day_begin;
+			if (w->day_end > end)
+				end = w->day_end;
+		}
+		if (end - begin >= CAL_MAX_REPEAT) {
+			warnx("window longer than %d days; "
+			      "events may be missed", CAL_MAX_REPEAT);
+		}
+
+		if (nparses++ > 0 && fseek(fp, 0L, SEEK_SET) == -1) {
+			warn("Cannot rewind calendar file");
+			return 1;
+		}
+
+		Options.today = windows[i].today;
+		Options.day_begin = begin;
+		Options.day_end = end;
+		DPRINTF("%s: parse #%d for windows [%d, %d): %d - %d\n",
+			__func__, nparses, i, j, begin, end);
+
+		generate_dates();
+		if (!cal_load(fp, NULL)) {
+			ret = 1;
+		} else {
+			for (int k = i; k < j; k++) {
+				w = &windows[k];
+				if ((fpout = window_open(w, outdir)) == NULL) {
+					ret = 1;
+					continue;
+				}
+				event_print_range(fpout, w->day_begin,
+						  w->day_end);
+				if (fpout != stdout)
+					fclose(fpout);
+			}
+		}
+		cal_unload();
+		free_dates();
+		cal_reset();
+	}
+
+	DPRINTF("%s: %d windows with %d parses\n", __func__, nwindows, nparses);
+	return ret;
+}
@@ -55,8 +55,12 @@
 #include <unistd.h>
 
 #include "calendar.h"
+#include "allmode.h"
+#include "almanac.h"
 #include "basics.h"
+#include "batch.h"
 #include "chinese.h"
+#include "daemon.h"
 #include "dates.h"
 #include "days.h"
 #include "gregorian.h"
@@ -69,12 +73,6 @@
 #include "utils.h"
 
 
-struct cal_options Options = {
-	.time = 0.5,  /* noon */
-	.allmode = false,
-	.debug = 0,
-};
-
 /* paths to search for calendar files for inclusion */
 const char *calendarDirs[] = {
 	".",  /* i.e., '~/.calendar' */
@@ -83,9 +81,6 @@ const char *calendarDirs[] = {
 	NULL,
 };
 
-/* currently selected calendar to use */
-struct calendar *Calendar;
-
 /* all supported calendars */
 static struct calendar calendars[] = {
 	{  /* the default */
@@ -121,6 +116,7 @@ static struct calendar calendars[] = {
 static const char *calendarHome = ".calendar";
 /* default calendar file to use if exists in current dir or ~/.calendar */
 static const char *calendarFile = "calendar";
+static char calendarPath[PATH_MAX];  /* absolute path of the opened file */
 /* system-wide calendar file to use if user doesn't have one */
 static const char *calendarFileSys = CALENDAR_ETCDIR "/default";
 /* don't send mail if this file exists in ~/.calendar */
@@ -131,6 +127,10 @@ static const int user_timeout = 10;
 static const int total_timeout = 3600;
 
 static bool	cd_home(const char *home);
+static FILE	*open_calfile(const char *path);
+static int	query_daemon(const char *socket_path, bool today_set);
+static int	read_batch(const char *path, int days_before, int days_after,
+			   int Friday, struct batch_window **windows_out);
 static int	get_fixed_of_today(void);
 static double	get_time_of_now(void);
 static int	get_utc_offset(void);
@@ -167,26 +167,39 @@ int
 main(int argc, char *argv[])
 {
 	bool	L_flag = false;
+	bool	range_flag = false;  /* whether '-A' or '-B' is given */
+	bool	t_flag = false;
 	int	ret = 0;
 	int	days_before = 0;
 	int	days_after = 0;
 	int	Friday = 5;  /* days before weekend */
+	int	nthreads = 0;  /* threads to evaluate all users (0 to fork) */
+	int	nwindows = 0;
 	int	dow;
 	int	ch, utc_offset;
 	struct passwd *pw;
 	struct location loc = { 0 };
+	struct location *locs = NULL;  /* all locations given by '-L' */
+	int nlocs = 0;
 	const char *show_info = NULL;
 	const char *calfile = NULL;
 	const char *calhome = NULL;
+	const char *serve_socket = NULL;
+	const char *query_socket = NULL;
+	const char *batch_list = NULL;
+	const char *batch_outdir = NULL;
+	char outdir[PATH_MAX];
 	const char *optstring;
+	char *localtz;
 	FILE *fp = NULL;
+	struct batch_window *windows = NULL;
 
 	Options.location = &loc;
 	Options.time = get_time_of_now();
 	Options.today = get_fixed_of_today();
 	loc.zone = get_utc_offset() / (3600.0 * 24.0);
 
-	optstring = "-A:aB:dF:f:hH:L:l:s:T:t:U:W:";
+	optstring = "-A:aB:b:C:DdF:f:hH:j:L:l:O:o:S:s:T:t:U:uW:";
 	while ((ch = getopt(argc, argv, optstring)) != -1) {
 		switch (ch) {
 		case '-':		/* backward compatible */
@@ -203,12 +216,28 @@ main(int argc, char *argv[])
 			days_after = (int)strtol(optarg, NULL, 10);
 			if (days_after < 0)
 				errx(1, "number of days must be positive");
+			range_flag = true;
 			break;
 
 		case 'B': /* days before current date */
 			days_before = (int)strtol(optarg, NULL, 10);
 			if (days_before < 0)
 				errx(1, "number of days must be positive");
+			range_flag = true;
+			break;
+
+		case 'b': /* list of dates to evaluate in batch */
+			batch_list = optarg;
+			if (strcmp(optarg, "-") == 0)
+				batch_list = "/dev/stdin";
+			break;
+
+		case 'C': /* query the daemon on the socket */
+			query_socket = optarg;
+			break;
+
+		case 'D': /* drop duplicate events */
+			Options.dedup = true;
 			break;
 
 		case 'd': /* show debug information */
@@ -229,14 +258,45 @@ main(int argc, char *argv[])
 			calhome = optarg;
 			break;
 
-		case 'L': /* location */
+		case 'j': /* threads to evaluate all users */
+			nthreads = (int)strtol(optarg, NULL, 10);
+			if (nthreads <= 0)
+				errx(1, "invalid thread count: |%s|", optarg);
+			break;
+
+		case 'L': /* location; the last one is used if repeated */
+			loc.elevation = 0.0;
 			if (!parse_location(optarg, &loc.latitude,
 					    &loc.longitude, &loc.elevation)) {
 				errx(1, "invalid location: |%s|", optarg);
 			}
+			locs = xrealloc(locs, (size_t)(nlocs + 1) * sizeof(*locs));
+			locs[nlocs++] = loc;
 			L_flag = true;
 			break;
 
+		case 'O': /* output directory of the batch */
+			/* resolve it before entering the calendar home */
+			if (realpath(optarg, outdir) == NULL)
+				err(1, "Invalid output directory: '%s'", optarg);
+			batch_outdir = outdir;
+			break;
+
+		case 'o': /* output format of the events */
+			if (strcmp(optarg, "text") == 0)
+				Options.output = OUTPUT_TEXT;
+			else if (strcmp(optarg, "json") == 0)
+				Options.output = OUTPUT_JSON;
+			else if (strcmp(optarg, "ics") == 0)
+				Options.output = OUTPUT_ICS;
+			else
+				errx(1, "unknown output format: |%s|", optarg);
+			break;
+
+		case 'S': /* serve the queries on the socket */
+			serve_socket = optarg;
+			break;
+
 		case 's': /* show info of specified category */
 			show_info = optarg;
 			break;
@@ -247,6 +307,7 @@ main(int argc, char *argv[])
 			break;
 
 		case 't': /* specify date */
+			t_flag = true;
 			if (!parse_date(optarg, &Options.today))
 				errx(1, "invalid date: |%s|", optarg);
 			break;
@@ -257,6 +318,10 @@ main(int argc, char *argv[])
 			loc.zone = utc_offset / (3600.0 * 24.0);
 			break;
 
+		case 'u': /* flush the output after each event */
+			Options.unbuffered = true;
+			break;
+
 		case 'h':
 		default:
 			usage(argv[0]);
@@ -266,13 +331,49 @@ main(int argc, char *argv[])
 	if (argc > optind)
 		usage(argv[0]);
 
+	if (Options.unbuffered)
+		setvbuf(stdout, NULL, _IOLBF, 0);
+	else
+		setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFSIZE);
+
 	if (Options.allmode && calfile != NULL)
 		errx(1, "flags -a and -f cannot be used together");
 	if (Options.allmode && calhome != NULL)
 		errx(1, "flags -a and -H cannot be used together");
-
-	if (!L_flag)
+	if (nthreads > 0 && !Options.allmode)
+		errx(1, "flag -j requires -a");
+	if (Options.allmode && (serve_socket != NULL || query_socket != NULL))
+		errx(1, "flag -a cannot be used with -C or -S");
+	if (serve_socket != NULL && query_socket != NULL)
+		errx(1, "flags -C and -S cannot be used together");
+	if (query_socket != NULL && calfile != NULL &&
+	    strcmp(calfile, "/dev/stdin") == 0)
+		errx(1, "flag -C cannot read the calendar from stdin");
+	if (batch_outdir != NULL && batch_list == NULL)
+		errx(1, "flag -O requires -b");
+	if (batch_list != NULL && (Options.allmode || serve_socket != NULL ||
+				   query_socket != NULL))
+		errx(1, "flag -b cannot be used with -a, -C or -S");
+	if (batch_list != NULL && calfile != NULL &&
+	    strcmp(batch_list, "/dev/stdin") == 0 &&
+	    strcmp(calfile, "/dev/stdin") == 0)
+		errx(1, "flags -b and -f cannot both read from stdin");
+
+	if (!L_flag) {
 		loc.longitude = loc.zone * 360.0;
+		locs = xmalloc(sizeof(*locs));
+		locs[nlocs++] = loc;
+	}
+	for (int i = 0; i < nlocs; i++)
+		locs[i].zone = loc.zone;
+
+	/* read the list before entering the calendar home */
+	if (batch_list != NULL) {
+		nwindows = read_batch(batch_list, days_before, days_after,
+				      Friday, &windows);
+		if (nwindows == 0)
+			errx(1, "No dates to evaluate in: '%s'", batch_list);
+	}
 
 	/* Friday displays Monday's events */
 	dow = dayofweek_from_fixed(Options.today);
@@ -287,11 +388,19 @@ main(int argc, char *argv[])
 	setlocale(LC_ALL, "");
 	set_nnames();
 
+	if ((localtz = getenv("TZ")) != NULL)
+		localtz = xstrdup(localtz);
 	if (setenv("TZ", "UTC", 1) != 0)
 		err(1, "setenv");
 	tzset();
 	/* We're in UTC from now on */
 
+	if (serve_socket != NULL) {
+		/* the dates are generated for each query */
+		free_dates();
+		return daemon_serve(serve_socket, localtz);
+	}
+
 	if (show_info != NULL) {
 		double t = Options.today + Options.time;
 		if (strcmp(show_info, "chinese") == 0) {
@@ -306,6 +415,25 @@ main(int argc, char *argv[])
 			print_datetime(t, Options.location);
 			print_location(Options.location, !L_flag);
 			show_sun_info(t, Options.location);
+		} else if (strcmp(show_info, "twilight") == 0) {
+			if (!L_flag)
+				print_location(Options.location, true);
+			show_twilight_info(Options.day_begin, Options.day_end,
+					   locs, nlocs);
+		} else if (strcmp(show_info, "almanac") == 0) {
+			int rd_begin = Options.day_begin;
+			int rd_end = Options.day_end;
+			if (!range_flag) {
+				/* the whole year of today */
+				int year = gregorian_year_from_fixed(
+						Options.today);
+				struct date date = { year, 1, 1 };
+				rd_begin = fixed_from_gregorian(&date);
+				date.year++;
+				rd_end = fixed_from_gregorian(&date) - 1;
+			}
+			print_location(Options.location, !L_flag);
+			show_almanac(rd_begin, rd_end, Options.location);
 		} else {
 			errx(1, "unknown -s value: |%s|", show_info);
 		}
@@ -313,7 +441,29 @@ main(int argc, char *argv[])
 		exit(0);
 	}
 
-	if (Options.allmode) {
+	if (Options.allmode && nthreads > 0) {
+		time_t t = time(NULL);
+
+		allmode_start(nthreads, user_timeout);
+		while ((pw = getpwent()) != NULL) {
+			/*
+			 * Enter '~/.calendar' and only try 'calendar'
+			 */
+			if (!cd_home(pw->pw_dir))
+				continue;
+			if (access(calendarNoMail, F_OK) == 0)
+				continue;
+			allmode_add(pw, calendarFile);
+
+			if (time(NULL) - t > total_timeout) {
+				errx(2, "'calendar -a' timed out (%d seconds); "
+					"stop at user %s (uid %u)",
+					total_timeout, pw->pw_name, pw->pw_uid);
+			}
+		}
+		allmode_finish();
+
+	} else if (Options.allmode) {
 		pid_t kid, deadkid, gkid;
 		time_t t;
 		bool reaped;
@@ -419,23 +569,23 @@ main(int argc, char *argv[])
 		}
 
 	} else {
-		if (calfile && (fp = fopen(calfile, "r")) == NULL)
+		if (calfile && (fp = open_calfile(calfile)) == NULL)
 			errx(1, "Cannot open calendar file: '%s'", calfile);
 
 		/* try 'calendar' in current directory */
 		if (fp == NULL)
-			fp = fopen(calendarFile, "r");
+			fp = open_calfile(calendarFile);
 
 		if (calhome) {
 			if (chdir(calhome) == -1)
 				errx(1, "Cannot enter home: '%s'", calhome);
 			/* try 'calendar' in home directory */
 			if (fp == NULL)
-				fp = fopen(calendarFile, "r");
+				fp = open_calfile(calendarFile);
 		} else if (cd_home(NULL)) {  /* try to enter '~/.calendar' */
 			/* try 'calendar' in home directory */
 			if (fp == NULL)
-				fp = fopen(calendarFile, "r");
+				fp = open_calfile(calendarFile);
 		} else {
 			DPRINTF("Fallback to enter '%s'\n", calendarDirs[1]);
 			/* fallback to '/etc/calendar' as home directory */
@@ -449,12 +599,21 @@ main(int argc, char *argv[])
 			warnx("No user's calendar file; "
 			      "fallback to system default: '%s'",
 			      calendarFileSys);
-			fp = fopen(calendarFileSys, "r");
+			fp = open_calfile(calendarFileSys);
 			if (fp == NULL)
 				errx(1, "Cannot find calendar file");
 		}
 
-		ret = cal(fp);
+		if (query_socket != NULL) {
+			ret = query_daemon(query_socket, t_flag);
+		} else if (windows != NULL) {
+			/* the dates are generated for each group of windows */
+			free_dates();
+			ret = batch_run(fp, windows, nwindows, batch_outdir);
+			free(windows);
+		} else {
+			ret = cal(fp);
+		}
 		fclose(fp);
 	}
 
@@ -469,6 +628,109 @@ handle_sigchld(int signo __unused)
 	/* empty; just let the main() to reap the child */
 }
 
+/*
+ * Open the calendar file and record its absolute path for the daemon.
+ */
+static FILE *
+open_calfile(const char *path)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+	if (realpath(path, calendarPath) == NULL)
+		calendarPath[0] = '\0';
+
+	return fp;
+}
+
+/*
+ * Read the list of dates to evaluate in batch from the file $path, with
+ * one date '[[[CC]YY]MM]DD' or range 'date1-date2' per line; blank lines
+ * and lines starting with '#' are ignored.  Each date gets a window as if
+ * given by '-t', with the same days before and after.
+ * Return the number of windows stored in $windows_out.
+ */
+static int
+read_batch(const char *path, int days_before, int days_after, int Friday,
+	   struct batch_window **windows_out)
+{
+	struct batch_window *windows = NULL;
+	FILE *fp;
+	char *line = NULL;
+	char *p, *sep;
+	size_t linecap = 0;
+	ssize_t linelen;
+	int n = 0, lineno = 0;
+	int rd, rd_first, rd_last, after;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		err(1, "Cannot open date list: '%s'", path);
+
+	while ((linelen = getline(&line, &linecap, fp)) > 0) {
+		lineno++;
+		p = triml(line);
+		trimr(p);
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		if ((sep = strchr(p, '-')) != NULL)
+			*sep++ = '\0';
+		if (!parse_date(trimr(p), &rd_first) ||
+		    !parse_date(sep ? triml(sep) : p, &rd_last) ||
+		    rd_first > rd_last) {
+			errx(1, "%s:%d: invalid date or range", path, lineno);
+		}
+
+		windows = xrealloc(windows, (size_t)(n + rd_last-rd_first + 1) *
+				   sizeof(*windows));
+		for (rd = rd_first; rd <= rd_last; rd++) {
+			after = days_after;
+			if (after == 0 && Friday != -1)
+				after = (dayofweek_from_fixed(rd) == Friday) ?
+					3 : 1;
+			windows[n].today = rd;
+			windows[n].day_begin = rd - days_before;
+			windows[n].day_end = rd + after;
+			n++;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	*windows_out = windows;
+	return n;
+}
+
+/*
+ * Query the events of the opened calendar file from the daemon, with the
+ * current directory as the calendar home.  The daemon uses its own date
+ * (rolled forward at midnight) unless $today_set is true.
+ */
+static int
+query_daemon(const char *socket_path, bool today_set)
+{
+	struct daemon_query query = { 0 };
+	char home[PATH_MAX];
+
+	if (calendarPath[0] == '\0')
+		errx(1, "Cannot resolve the path of the calendar file");
+	if (getcwd(home, sizeof(home)) == NULL)
+		err(1, "getcwd");
+
+	query.file = calendarPath;
+	query.home = home;
+	query.today_set = today_set;
+	query.today = Options.today;
+	query.days_before = Options.today - Options.day_begin;
+	query.days_after = Options.day_end - Options.today;
+	query.location = *Options.location;
+	query.output = Options.output;
+	query.dedup = Options.dedup;
+
+	return daemon_query(socket_path, &query);
+}
+
 static double
 get_time_of_now(void)
 {
@@ -567,10 +829,13 @@ usage(const char *progname)
 {
 	fprintf(stderr,
 		"usage:\n"
-		"%s [-A days] [-a] [-B days] [-d] [-F friday]\n"
-		"\t[-f calendar_file] [-H calendar_home]\n"
-		"\t[-L latitude,longitude[,elevation]] [-s category]\n"
-		"\t[-T hh:mm[:ss]] [-t [[[CC]YY]MM]DD] [-U ±hh[[:]mm]] [-W days]\n",
+		"%s [-A days] [-a] [-B days] [-b date_list] [-C socket] [-D]\n"
+		"\t[-d] [-F friday] [-f calendar_file] [-H calendar_home]\n"
+		"\t[-j threads] [-L latitude,longitude[,elevation]]\n"
+		"\t[-O output_dir] [-o format] [-S socket]\n"
+		"\t[-s category]\n"
+		"\t[-T hh:mm[:ss]] [-t [[[CC]YY]MM]DD] [-U ±hh[[:]mm]] [-u]\n"
+		"\t[-W days]\n",
 		progname);
 	exit(1);
 }
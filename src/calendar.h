@@ -38,8 +38,12 @@
 #ifndef CALENDAR_H_
 #define CALENDAR_H_
 
+#include <sys/types.h>
+
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <time.h>
 
 #ifndef __unused
 #define __unused	__attribute__((__unused__))
@@ -55,6 +59,12 @@
  */
 #define CAL_MAX_REPEAT	100
 
+/*
+ * Buffer size of the event output, which is flushed once at the end
+ * unless Options.unbuffered is set.
+ */
+#define OUTPUT_BUFSIZE	(64 * 1024)
+
 #define DPRINTF(...) \
 	if (Options.debug) fprintf(stderr, __VA_ARGS__)
 #define DPRINTF2(...) \
@@ -74,6 +84,16 @@ struct cal_options {
 	int day_end;  /* end of date range to remind events */
 	int debug;  /* debug log level (higher means more verbose) */
 	bool allmode;  /* whether to process calendars for all users */
+	bool unbuffered;  /* whether to flush the output after each event */
+	bool dedup;  /* whether to drop the duplicate events of a day */
+	int output;  /* output format of the events */
+};
+
+/* output formats of the events */
+enum {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,  /* JSON Lines */
+	OUTPUT_ICS,  /* iCalendar (RFC 5545) */
 };
 
 /* IDs of supported calendars */
@@ -96,10 +116,71 @@ struct calendar {
 				  struct cal_day **dayp, char **edp);
 };
 
-extern struct cal_options Options;
-extern struct calendar *Calendar;
+struct cal_cache;
+struct cal_desc;
+struct event_slot;
+struct nname;
+struct node;
+struct specialday;
+
+/*
+ * Context of evaluating the calendar files, holding all the state of
+ * parsing the files, finding the dates and printing the events.  Each
+ * thread evaluates in its current context (the default one unless set by
+ * cal_context_set()), so different contexts can be evaluated concurrently.
+ */
+struct cal_context {
+	struct cal_options options;
+	struct calendar	*calendar;  /* currently selected calendar */
+
+	/* dates.c: days in the range and their events */
+	struct cal_day	**day_pages;
+	int		 npages;
+	int		 locale_generation;
+	struct event_slot *event_slots;  /* table of the events to dedup */
+	size_t		 event_size;  /* number of slots; a power of 2 */
+	size_t		 event_count;  /* number of used slots */
+
+	/* io.c: parsed calendar files */
+	struct cal_desc	*descriptions;
+	struct node	*definitions;
+	char		**included_files;  /* files included by cal_print() */
+	int		 nincluded;
+	int		 maxincluded;
+	time_t		 deadline;  /* time to give up parsing, or 0 */
+	char		*lang;  /* value of 'LANG' in effect, or NULL */
+	struct cal_cache *cache;  /* parsed files shared with other contexts */
+
+	/* io.c: hook to open the calendar files (NULL to use fopen()) */
+	FILE		*(*open_file)(const char *path, void *arg);
+	void		*open_arg;
+
+	/* io.c: user to mail the events to (NULL for the current user) */
+	const char	*mail_user;
+	uid_t		 mail_uid;
+	gid_t		 mail_gid;
+	const gid_t	*mail_groups;  /* supplementary groups of the user */
+	int		 mail_ngroups;
+
+	/* nnames.c and days.c: names set by the locale and variables */
+	struct nname	*dow_names;
+	struct nname	*month_names;
+	struct nname	*sequence_names;
+	struct specialday *specialdays;
+};
+
+extern __thread struct cal_context *cal_ctx;  /* context of the thread */
+
+/* the former globals, now in the current context */
+#define Options		(cal_ctx->options)
+#define Calendar	(cal_ctx->calendar)
+
 extern const char *calendarDirs[];  /* paths to search for calendar files */
 
+struct cal_context *cal_context_new(void);
+void	cal_context_free(struct cal_context *ctx);
+struct cal_context *cal_context_set(struct cal_context *ctx);
+
 bool	set_calendar(const char *name);
 
 #endif
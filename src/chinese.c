@@ -71,6 +71,24 @@
  */
 static const int epoch = -963099;  /* Gregorian: -2636, February, 15 */
 
+/*
+ * Precomputed layout of a Chinese year, i.e., from a Chinese New Year up
+ * to (but excluding) the next one.
+ */
+struct chinese_year {
+	int	newyear;	/* fixed date of the Chinese New Year */
+	int	bigmonths;	/* bit (i) set if the (i+1)-th month has 30 days */
+	int	leap;		/* position [1, 13] of the leap month; 0 if none */
+};
+
+#ifndef CHINESE_NO_TABLE
+/*
+ * Table of Chinese years (chinese_years[], starting from the Gregorian
+ * year CHINESE_TABLE_BEGIN), generated by 'make chinese-table'.
+ */
+#include "chinese_table.h"
+#endif
+
 /*
  * Timezone (in fraction of days) of Beijing adopted in Chinese calendar
  * calculations.
@@ -96,6 +114,61 @@ midnight_in_china(int rd)
 	return (double)rd - chinese_zone(rd);
 }
 
+/*
+ * The 24 solar terms (jiéqì) of a Gregorian year, in the order of occurrence,
+ * i.e., from Xiǎohán (小寒; 285°) in January to Dōngzhì (冬至; 270°) in
+ * December.  The terms of odd index are the major ones (zhōngqì).
+ */
+struct jieqi_year {
+	int	year;		/* Gregorian year */
+	bool	valid;
+	double	moments[24];	/* moments in universal time */
+	int	dates[24];	/* fixed dates in China */
+};
+
+/* number of cached years; must be a power of 2 */
+#define JIEQI_CACHE_SIZE	8
+
+/*
+ * Longitude of Sun at the $k-th solar term of a Gregorian year.
+ */
+static int
+jieqi_longitude(int k)
+{
+	return mod(285 + 15 * k, 360);
+}
+
+/*
+ * Get the solar terms of the Gregorian year $year, which are calculated
+ * only once and then cached.
+ */
+static const struct jieqi_year *
+jieqi_get_year(int year)
+{
+	static __thread struct jieqi_year cache[JIEQI_CACHE_SIZE];
+	struct jieqi_year *jy;
+	struct date date = { year, 1, 1 };
+	double zone, t;
+	int rd;
+
+	jy = &cache[mod(year, JIEQI_CACHE_SIZE)];
+	if (jy->valid && jy->year == year)
+		return jy;
+
+	rd = fixed_from_gregorian(&date);
+	zone = chinese_zone(rd);
+	t = (double)rd - zone;
+	for (int k = 0; k < 24; k++) {
+		t = solar_longitude_atafter(jieqi_longitude(k), t);
+		jy->moments[k] = t;
+		jy->dates[k] = (int)floor(t + zone);
+	}
+
+	jy->year = year;
+	jy->valid = true;
+	return jy;
+}
+
 /*
  * Calculate the last Chinese major solar term (zhōngqì) in range of [1, 12]
  * before the fixed date $rd.
@@ -105,29 +178,35 @@ static int
 current_major_solar_term(int rd)
 {
 	double t_u = midnight_in_china(rd);
-	double lon = solar_longitude(t_u);
-	return mod1(2 + div_floor((int)lon, 30), 12);
+	int year = gregorian_year_from_fixed(rd);
+	const struct jieqi_year *jy = jieqi_get_year(year);
+
+	for (int k = 23; k > 0; k -= 2) {
+		if (jy->moments[k] <= t_u)
+			return mod1(2 + jieqi_longitude(k) / 30, 12);
+	}
+
+	/* before Dàhán, so still in the month of the last Dōngzhì */
+	return mod1(2 + jieqi_longitude(23) / 30, 12);
 }
 
 /*
  * Calculate the fixed date (in China) of winter solstice on or before the
  * given fixed date $rd.
  * Ref: Sec.(19.1), Eq.(19.8)
+ *
+ * Instead of stepping day by day from an estimate and comparing the solar
+ * longitudes at midnight, take the date of Dōngzhì (冬至), which is solved
+ * as the root of the solar longitude by 'jieqi_get_year()'.
  */
 static int
 chinese_winter_solstice_onbefore(int rd)
 {
-	/* longitude of Sun at winter solstice */
-	const double winter = 270.0;
+	int year = gregorian_year_from_fixed(rd);
+	int day = jieqi_get_year(year)->dates[23];
 
-	/* approximate the time of winter solstice */
-	double t = midnight_in_china(rd + 1);
-	double approx = estimate_prior_solar_longitude(winter, t);
-
-	/* search for the date of winter solstice */
-	int day = (int)floor(approx) - 1;
-	while (winter >= solar_longitude(midnight_in_china(day+1)))
-		day++;
+	if (day > rd)
+		day = jieqi_get_year(year - 1)->dates[23];
 
 	return day;
 }
@@ -161,31 +240,97 @@ chinese_new_moon_before(int rd)
 }
 
 /*
- * Determine whether the Chinese lunar month starting on the given fixed
- * date $rd has no major solar term.
- * Ref: Sec.(19.2), Eq.(19.11)
+ * Layout of a suì, i.e., the period from the winter solstice $s1 up to
+ * (but excluding) the next winter solstice $s2.  The lunar months are
+ * listed from the 11th month (that contains $s1) until the last month
+ * starting before $s2.
  */
-static bool
-chinese_no_major_solar_term(int rd)
+struct chinese_sui {
+	int	s1;		/* fixed date of the prior winter solstice */
+	int	s2;		/* fixed date of the following winter solstice */
+	int	newyear;	/* fixed date of the Chinese New Year */
+	int	nmonths;
+	int	starts[15];	/* fixed dates of the month starts */
+	int	months[15];	/* month numbers: [1, 12] */
+	bool	leaps[15];	/* whether the month is a leap month */
+};
+
+#define SUI_CACHE_SIZE	4
+
+/*
+ * Calculate the layout of the suì containing the given fixed date $rd.
+ *
+ * This is the iterative form of chinese-prior-leap-month? used in
+ * Eq.(19.12), (19.13) and (19.16): the months of a suì are consecutive
+ * new moons, so a single forward pass tells both the month numbers and
+ * the leap month.
+ */
+static void
+chinese_sui_layout(int rd, struct chinese_sui *sui)
 {
-	int rd2 = chinese_new_moon_onafter(rd + 1);
-	return (current_major_solar_term(rd) ==
-		current_major_solar_term(rd2));
+	bool nomajor[15];
+	bool leap_year, prior_leap;
+	int i, m, m12, m11_next;
+
+	sui->s1 = chinese_winter_solstice_onbefore(rd);
+	sui->s2 = chinese_winter_solstice_onbefore(sui->s1 + 370);
+
+	m = chinese_new_moon_before(sui->s1 + 1);
+	for (i = 0; m < sui->s2 && i < (int)nitems(sui->starts); i++) {
+		sui->starts[i] = m;
+		m = chinese_new_moon_onafter(m + 1);
+		nomajor[i] = (current_major_solar_term(sui->starts[i]) ==
+			      current_major_solar_term(m));
+	}
+	sui->nmonths = i;
+
+	/* month after the 11th month: either 12 or leap 11 */
+	m12 = sui->starts[1];
+	/* the next 11th month, i.e., the month containing $s2 */
+	m11_next = (m == sui->s2) ? m : sui->starts[sui->nmonths - 1];
+	leap_year = (lround((m11_next - m12) / mean_synodic_month) == 12);
+
+	sui->months[0] = 11;
+	sui->leaps[0] = false;
+	prior_leap = false;
+	for (i = 1; i < sui->nmonths; i++) {
+		sui->leaps[i] = (leap_year && !prior_leap && nomajor[i]);
+		if (sui->leaps[i])
+			prior_leap = true;
+		sui->months[i] = mod1(i - 1 - (prior_leap ? 1 : 0), 12);
+	}
+
+	if (leap_year && (nomajor[1] || nomajor[2])) {
+		/* either m12 or m13 is a leap month */
+		sui->newyear = sui->starts[3];
+	} else {
+		sui->newyear = sui->starts[2];
+	}
 }
 
 /*
- * Recursively determine whether there is a Chinese leap month on or
- * after the lunar month starting on fixed date $m1 and at or before
- * the lunar month starting on fixed date $m2.
- * Ref: Sec.(19.2), Eq.(19.12)
+ * Get the (cached) layout of the suì containing the given fixed date $rd.
  */
-static bool
-chinese_prior_leap_month(int m1, int m2)
+static const struct chinese_sui *
+chinese_sui_get(int rd)
 {
-	int m2_prev = chinese_new_moon_before(m2);
-	return ((m2 >= m1) &&
-		(chinese_no_major_solar_term(m2) ||
-		 chinese_prior_leap_month(m1, m2_prev)));
+	static __thread struct chinese_sui cache[SUI_CACHE_SIZE];
+	static __thread int ncached = 0, next = 0;
+	struct chinese_sui *sui;
+
+	for (int i = 0; i < ncached; i++) {
+		sui = &cache[i];
+		if (rd >= sui->s1 && rd < sui->s2)
+			return sui;
+	}
+
+	sui = &cache[next];
+	chinese_sui_layout(rd, sui);
+	next = (next + 1) % SUI_CACHE_SIZE;
+	if (ncached < SUI_CACHE_SIZE)
+		ncached++;
+
+	return sui;
 }
 
 /*
@@ -196,25 +341,7 @@ chinese_prior_leap_month(int m1, int m2)
 static int
 chinese_new_year_in_sui(int rd)
 {
-	/* prior and following winter solstice */
-	int s1 = chinese_winter_solstice_onbefore(rd);
-	int s2 = chinese_winter_solstice_onbefore(s1 + 370);
-
-	/* month after the 11th month: either 12 or leap 11 */
-	int m12 = chinese_new_moon_onafter(s1 + 1);
-	/* month after m12: either 12 (or leap 12) or 1 */
-	int m13 = chinese_new_moon_onafter(m12 + 1);
-	/* the next 11th month */
-	int m11_next = chinese_new_moon_before(s2 + 1);
-
-	bool leap_year = (lround((m11_next - m12) / mean_synodic_month) == 12);
-	if (leap_year && (chinese_no_major_solar_term(m12) ||
-			  chinese_no_major_solar_term(m13))) {
-		/* either m12 or m13 is a leap month */
-		return chinese_new_moon_onafter(m13 + 1);
-	} else {
-		return m13;
-	}
+	return chinese_sui_get(rd)->newyear;
 }
 
 /*
@@ -232,6 +359,44 @@ chinese_new_year_onbefore(int rd)
 		return chinese_new_year_in_sui(rd - 180);
 }
 
+#ifndef CHINESE_NO_TABLE
+/*
+ * Get the precomputed Chinese year starting in Gregorian year $year,
+ * or NULL if it is not covered by the table.
+ */
+static const struct chinese_year *
+chinese_table_year(int year)
+{
+	int i = year - CHINESE_TABLE_BEGIN;
+
+	if (i < 0 || i >= (int)nitems(chinese_years))
+		return NULL;
+	return &chinese_years[i];
+}
+
+/*
+ * Get the precomputed Chinese year containing the fixed date $rd, or
+ * NULL if it is not covered by the table.  The Gregorian year in which
+ * the Chinese year starts is stored into $year.
+ */
+static const struct chinese_year *
+chinese_table_lookup(int rd, int *year)
+{
+	const struct chinese_year *cy;
+	int g_year = gregorian_year_from_fixed(rd);
+
+	if ((cy = chinese_table_year(g_year)) != NULL && rd < cy->newyear) {
+		g_year--;
+		cy = chinese_table_year(g_year);
+	}
+	if (cy == NULL)
+		return NULL;
+
+	*year = g_year;
+	return cy;
+}
+#endif
+
 /*
  * Calculate the fixed date of Chinese New Year in Gregorian year $year.
  * Ref: Sec.(19.6), Eq.(19.26)
@@ -239,6 +404,12 @@ chinese_new_year_onbefore(int rd)
 int
 chinese_new_year(int year)
 {
+#ifndef CHINESE_NO_TABLE
+	const struct chinese_year *cy = chinese_table_year(year);
+	if (cy != NULL)
+		return cy->newyear;
+#endif
+
 	struct date date = { year, 7, 1 };
 	int july1 = fixed_from_gregorian(&date);
 	return chinese_new_year_onbefore(july1);
@@ -252,35 +423,48 @@ chinese_new_year(int year)
 void
 chinese_from_fixed(int rd, struct chinese_date *date)
 {
-	/* prior and following winter solstice */
-	int s1 = chinese_winter_solstice_onbefore(rd);
-	int s2 = chinese_winter_solstice_onbefore(s1 + 370);
-
-	/* start of month containing the given date */
-	int m = chinese_new_moon_before(rd + 1);
-	/* start of the previous month */
-	int m_prev = chinese_new_moon_before(m);
-	/* month after the last 11th month: either 12 or leap 11 */
-	int m12 = chinese_new_moon_onafter(s1 + 1);
-	/* the next 11th month */
-	int m11_next = chinese_new_moon_before(s2 + 1);
-
-	bool leap_year = (lround((m11_next - m12) / mean_synodic_month) == 12);
-	int month = (int)lround((m - m12) / mean_synodic_month);
-	if (leap_year && chinese_prior_leap_month(m12, m))
-		month--;
-	month = mod1(month, 12);
-	bool leap_month = (leap_year &&
-			   chinese_no_major_solar_term(m) &&
-			   !chinese_prior_leap_month(m12, m_prev));
+#ifndef CHINESE_NO_TABLE
+	const struct chinese_year *cy;
+	int g_year;
+
+	if ((cy = chinese_table_lookup(rd, &g_year)) != NULL) {
+		int start = cy->newyear;
+		int pos = 1, length;
+		for (;;) {
+			length = (cy->bigmonths & (1 << (pos - 1))) ? 30 : 29;
+			if (rd < start + length)
+				break;
+			start += length;
+			pos++;
+		}
+
+		/* Chinese year 1 began in Gregorian year -2636 */
+		int elapsed_years = g_year + 2637;
+		date->cycle = div_floor(elapsed_years - 1, 60) + 1;
+		date->year = mod1(elapsed_years, 60);
+		date->month = (cy->leap > 0 && pos >= cy->leap) ? pos - 1 : pos;
+		date->leap = (pos == cy->leap);
+		date->day = rd - start + 1;
+		return;
+	}
+#endif
+
+	const struct chinese_sui *sui = chinese_sui_get(rd);
+
+	/* month containing the given date */
+	int i = sui->nmonths - 1;
+	while (i > 0 && sui->starts[i] > rd)
+		i--;
+
+	int month = sui->months[i];
 	int elapsed_years = (int)floor(1.5 - month/12.0 +
 				       (rd - epoch) / mean_tropical_year);
 
 	date->cycle = div_floor(elapsed_years - 1, 60) + 1;
 	date->year = mod1(elapsed_years, 60);
 	date->month = month;
-	date->leap = leap_month;
-	date->day = rd - m + 1;
+	date->leap = sui->leaps[i];
+	date->day = rd - sui->starts[i] + 1;
 }
 
 /*
@@ -291,6 +475,26 @@ chinese_from_fixed(int rd, struct chinese_date *date)
 int
 fixed_from_chinese(const struct chinese_date *date)
 {
+#ifndef CHINESE_NO_TABLE
+	/* Chinese year 1 began in Gregorian year -2636 */
+	int g_year = (date->cycle - 1) * 60 + date->year - 2637;
+	const struct chinese_year *cy = chinese_table_year(g_year);
+
+	if (cy != NULL) {
+		int nmonths = (cy->leap > 0) ? 13 : 12;
+		int start = cy->newyear;
+		for (int pos = 1; pos <= nmonths; pos++) {
+			int month = (cy->leap > 0 && pos >= cy->leap) ?
+				pos - 1 : pos;
+			if (month == date->month &&
+			    (pos == cy->leap) == date->leap)
+				return start + date->day - 1;
+			start += (cy->bigmonths & (1 << (pos - 1))) ? 30 : 29;
+		}
+		/* no such (leap) month in this year; fall back */
+	}
+#endif
+
 	int midyear = (int)floor(epoch + mean_tropical_year *
 				 ((date->cycle - 1) * 60 + date->year - 0.5));
 	int newyear = chinese_new_year_onbefore(midyear);
@@ -315,12 +519,9 @@ fixed_from_chinese(const struct chinese_date *date)
 int
 chinese_qingming(int g_year)
 {
-	double lambda = 15.0;  /* Solar longitude of Qīngmíng */
-	struct date date = { g_year, 4, 1 }; /* Qīngmíng is around April 5 */
-	int rd = fixed_from_gregorian(&date);
-	double zone = chinese_zone(rd);
-	double t = solar_longitude_atafter(lambda, rd) + zone;
-	return (int)floor(t);
+	/* Qīngmíng (15°) is the 7th solar term in the year */
+	const struct jieqi_year *jy = jieqi_get_year(g_year);
+	return jy->dates[6];
 }
 
 /**************************************************************************/
@@ -404,6 +605,27 @@ static const struct chinese_jieqi jieqis[] = {
 	{ "Dàhán",       "大寒", true,  300 },
 };
 
+/*
+ * Calculate the moment (in universal time) of the following jiéqì at or
+ * after the given moment $t, with the jiéqì information stored in $jieqi.
+ */
+double
+chinese_jieqi_atafter(double t, const struct chinese_jieqi **jieqi)
+{
+	const struct jieqi_year *jy;
+	int year = gregorian_year_from_fixed((int)floor(t));
+
+	for (;; year++) {
+		jy = jieqi_get_year(year);
+		for (int k = 0; k < 24; k++) {
+			if (jy->moments[k] >= t) {
+				*jieqi = &jieqis[(k + 22) % 24];
+				return jy->moments[k];
+			}
+		}
+	}
+}
+
 /*
  * Calculate the fixed date (in China) of the following jiéqì on or after
  * the given fixed date $rd, with the calculated jiéqì information stored
@@ -415,35 +637,24 @@ static const struct chinese_jieqi jieqis[] = {
 int
 chinese_jieqi_onafter(int rd, int type, const struct chinese_jieqi **jieqi)
 {
-	const struct chinese_jieqi *jq1, *jq2;
-	const double zone = chinese_zone(rd);
+	const struct jieqi_year *jy;
 	double t_u = midnight_in_china(rd);
-	double lon = solar_longitude(t_u);
-	double lon1, lon2;
-	size_t n = nitems(jieqis);
-
-	for (size_t i = 0; i < n; i++) {
-		jq1 = &jieqis[i];
-		jq2 = &jieqis[(i+1) % n];
-		if ((type == C_JIEQI_MINOR && jq2->is_major) ||
-		    (type == C_JIEQI_MAJOR && !jq2->is_major)) {
-			jq2 = &jieqis[(i+2) % n];
-		}
-
-		lon1 = jq1->longitude;
-		lon2 = jq2->longitude;
-		if (lon2 < lon1)
-			lon2 += 360;
-
-		if ((lon >= lon1 && lon < lon2) ||
-		    (lon + 360 >= lon1 && lon + 360 < lon2)) {
-			break;
+	int year = gregorian_year_from_fixed(rd);
+	bool major;
+
+	for (;; year++) {
+		jy = jieqi_get_year(year);
+		for (int k = 0; k < 24; k++) {
+			major = (k % 2 == 1);
+			if ((type == C_JIEQI_MINOR && major) ||
+			    (type == C_JIEQI_MAJOR && !major))
+				continue;
+			if (jy->moments[k] >= t_u) {
+				*jieqi = &jieqis[(k + 22) % 24];
+				return jy->dates[k];
+			}
 		}
 	}
-
-	t_u = solar_longitude_atafter(jq2->longitude, floor(t_u));
-	*jieqi = jq2;
-	return (int)floor(t_u + zone);
 }
 
 
@@ -546,26 +757,30 @@ show_chinese_calendar(int rd)
 
 	const double zone = chinese_zone(rd);
 	const struct chinese_jieqi *jq;
+	const struct jieqi_year *jy;
 	double t_jq;
 	char buf_time[32], buf_zone[32];
-	int lambda;
-
-	/* 1st solar term (Lìchūn) is generally around February 4 */
-	date_set(&gdate, g_year, 2, 1);
-	t_jq = (double)fixed_from_gregorian(&gdate);
+	int k;
 
 	format_zone(buf_zone, sizeof(buf_zone), zone);
 
+	/* from the 1st solar term (Lìchūn) around February 4 */
 	printf("\n二十四节气 (solar terms):\n");
 	for (size_t i = 0; i < nitems(jieqis); i++) {
 		jq = &jieqis[i];
-		lambda = jq->longitude;
-		t_jq = solar_longitude_atafter(lambda, floor(t_jq)) + zone;
-		gregorian_from_fixed(floor(t_jq), &gdate);
+		k = (int)i + 2;
+		if (k < 24) {
+			jy = jieqi_get_year(g_year);
+		} else {
+			jy = jieqi_get_year(g_year + 1);
+			k -= 24;
+		}
+		t_jq = jy->moments[k] + zone;
+		gregorian_from_fixed((int)floor(t_jq), &gdate);
 		format_time(buf_time, sizeof(buf_time), t_jq);
 
 		printf("%s (%-13s): %3d°, %d-%02d-%02d %s %s\n",
-		       jq->zhname, jq->name, lambda,
+		       jq->zhname, jq->name, jq->longitude,
 		       gdate.year, gdate.month, gdate.day,
 		       buf_time, buf_zone);
 	}
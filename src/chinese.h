@@ -65,6 +65,7 @@ int	fixed_from_chinese(const struct chinese_date *date);
 
 int	chinese_qingming(int g_year);
 int	chinese_jieqi_onafter(int rd, int type, const struct chinese_jieqi **jieqi);
+double	chinese_jieqi_atafter(double t, const struct chinese_jieqi **jieqi);
 
 int	chinese_format_date(char *buf, size_t size, int rd);
 int	chinese_find_days_ymd(int year, int month, int day, struct cal_day **dayp,
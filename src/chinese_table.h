@@ -0,0 +1,212 @@
+/*
+ * Chinese years of 1900 - 2100.
+ *
+ * Generated by tools/gen-chinese-table.c; DO NOT EDIT.
+ * Regenerate with 'make -f GNUmakefile chinese-table'.
+ */
+
+#define CHINESE_TABLE_BEGIN	1900
+
+static const struct chinese_year chinese_years[] = {
+	{ 693626, 0x16d2,  9 },  /* 1900 */
+	{ 694010, 0x0752,  0 },  /* 1901 */
+	{ 694364, 0x0ea5,  0 },  /* 1902 */
+	{ 694719, 0x164a,  6 },  /* 1903 */
+	{ 695102, 0x064b,  0 },  /* 1904 */
+	{ 695456, 0x0a9b,  0 },  /* 1905 */
+	{ 695811, 0x155a,  5 },  /* 1906 */
+	{ 696195, 0x056a,  0 },  /* 1907 */
+	{ 696549, 0x0b59,  0 },  /* 1908 */
+	{ 696904, 0x1752,  3 },  /* 1909 */
+	{ 697288, 0x0752,  0 },  /* 1910 */
+	{ 697642, 0x1b25,  7 },  /* 1911 */
+	{ 698026, 0x0b25,  0 },  /* 1912 */
+	{ 698380, 0x0a4b,  0 },  /* 1913 */
+	{ 698734, 0x14ab,  6 },  /* 1914 */
+	{ 699118, 0x02ad,  0 },  /* 1915 */
+	{ 699472, 0x056b,  0 },  /* 1916 */
+	{ 699827, 0x0b69,  3 },  /* 1917 */
+	{ 700211, 0x0da9,  0 },  /* 1918 */
+	{ 700566, 0x1d92,  8 },  /* 1919 */
+	{ 700950, 0x0e92,  0 },  /* 1920 */
+	{ 701304, 0x0d25,  0 },  /* 1921 */
+	{ 701658, 0x1a4d,  6 },  /* 1922 */
+	{ 702042, 0x0a56,  0 },  /* 1923 */
+	{ 702396, 0x02b6,  0 },  /* 1924 */
+	{ 702750, 0x15b5,  5 },  /* 1925 */
+	{ 703135, 0x06d4,  0 },  /* 1926 */
+	{ 703489, 0x0ea9,  0 },  /* 1927 */
+	{ 703844, 0x1e92,  3 },  /* 1928 */
+	{ 704228, 0x0e92,  0 },  /* 1929 */
+	{ 704582, 0x0d26,  7 },  /* 1930 */
+	{ 704965, 0x052b,  0 },  /* 1931 */
+	{ 705319, 0x0a57,  0 },  /* 1932 */
+	{ 705674, 0x12b6,  6 },  /* 1933 */
+	{ 706058, 0x0b5a,  0 },  /* 1934 */
+	{ 706413, 0x06d4,  0 },  /* 1935 */
+	{ 706767, 0x0ec9,  4 },  /* 1936 */
+	{ 707151, 0x0749,  0 },  /* 1937 */
+	{ 707505, 0x1693,  8 },  /* 1938 */
+	{ 707889, 0x0a93,  0 },  /* 1939 */
+	{ 708243, 0x052b,  0 },  /* 1940 */
+	{ 708597, 0x0a5b,  7 },  /* 1941 */
+	{ 708981, 0x0aad,  0 },  /* 1942 */
+	{ 709336, 0x056a,  0 },  /* 1943 */
+	{ 709690, 0x1b55,  5 },  /* 1944 */
+	{ 710075, 0x0ba4,  0 },  /* 1945 */
+	{ 710429, 0x0b49,  0 },  /* 1946 */
+	{ 710783, 0x1a93,  3 },  /* 1947 */
+	{ 711167, 0x0a95,  0 },  /* 1948 */
+	{ 711521, 0x152d,  8 },  /* 1949 */
+	{ 711905, 0x0536,  0 },  /* 1950 */
+	{ 712259, 0x0aad,  0 },  /* 1951 */
+	{ 712614, 0x15aa,  6 },  /* 1952 */
+	{ 712998, 0x05b2,  0 },  /* 1953 */
+	{ 713352, 0x0da5,  0 },  /* 1954 */
+	{ 713707, 0x1d4a,  4 },  /* 1955 */
+	{ 714091, 0x0d4a,  0 },  /* 1956 */
+	{ 714445, 0x0a95,  9 },  /* 1957 */
+	{ 714828, 0x0a97,  0 },  /* 1958 */
+	{ 715183, 0x0556,  0 },  /* 1959 */
+	{ 715537, 0x0ab5,  7 },  /* 1960 */
+	{ 715921, 0x0ad5,  0 },  /* 1961 */
+	{ 716276, 0x06d2,  0 },  /* 1962 */
+	{ 716630, 0x0ea5,  5 },  /* 1963 */
+	{ 717014, 0x0ea5,  0 },  /* 1964 */
+	{ 717369, 0x064a,  0 },  /* 1965 */
+	{ 717722, 0x0c97,  4 },  /* 1966 */
+	{ 718106, 0x0a9b,  0 },  /* 1967 */
+	{ 718461, 0x155a,  8 },  /* 1968 */
+	{ 718845, 0x056a,  0 },  /* 1969 */
+	{ 719199, 0x0b69,  0 },  /* 1970 */
+	{ 719554, 0x1752,  6 },  /* 1971 */
+	{ 719938, 0x0b52,  0 },  /* 1972 */
+	{ 720292, 0x0b25,  0 },  /* 1973 */
+	{ 720646, 0x164b,  5 },  /* 1974 */
+	{ 721030, 0x0a4b,  0 },  /* 1975 */
+	{ 721384, 0x14ab,  9 },  /* 1976 */
+	{ 721768, 0x02ad,  0 },  /* 1977 */
+	{ 722122, 0x056d,  0 },  /* 1978 */
+	{ 722477, 0x0b69,  7 },  /* 1979 */
+	{ 722861, 0x0da9,  0 },  /* 1980 */
+	{ 723216, 0x0d92,  0 },  /* 1981 */
+	{ 723570, 0x1d25,  5 },  /* 1982 */
+	{ 723954, 0x0d25,  0 },  /* 1983 */
+	{ 724308, 0x1a4d, 11 },  /* 1984 */
+	{ 724692, 0x0a56,  0 },  /* 1985 */
+	{ 725046, 0x02b6,  0 },  /* 1986 */
+	{ 725400, 0x05b5,  7 },  /* 1987 */
+	{ 725784, 0x06d5,  0 },  /* 1988 */
+	{ 726139, 0x0ea9,  0 },  /* 1989 */
+	{ 726494, 0x1e92,  6 },  /* 1990 */
+	{ 726878, 0x0e92,  0 },  /* 1991 */
+	{ 727232, 0x0d26,  0 },  /* 1992 */
+	{ 727586, 0x0a56,  4 },  /* 1993 */
+	{ 727969, 0x0a57,  0 },  /* 1994 */
+	{ 728324, 0x14d6,  9 },  /* 1995 */
+	{ 728708, 0x035a,  0 },  /* 1996 */
+	{ 729062, 0x06d5,  0 },  /* 1997 */
+	{ 729417, 0x16c9,  6 },  /* 1998 */
+	{ 729801, 0x0749,  0 },  /* 1999 */
+	{ 730155, 0x0693,  0 },  /* 2000 */
+	{ 730509, 0x152b,  5 },  /* 2001 */
+	{ 730893, 0x052b,  0 },  /* 2002 */
+	{ 731247, 0x0a5b,  0 },  /* 2003 */
+	{ 731602, 0x155a,  3 },  /* 2004 */
+	{ 731986, 0x056a,  0 },  /* 2005 */
+	{ 732340, 0x1b55,  8 },  /* 2006 */
+	{ 732725, 0x0ba4,  0 },  /* 2007 */
+	{ 733079, 0x0b49,  0 },  /* 2008 */
+	{ 733433, 0x1a93,  6 },  /* 2009 */
+	{ 733817, 0x0a95,  0 },  /* 2010 */
+	{ 734171, 0x052d,  0 },  /* 2011 */
+	{ 734525, 0x0aad,  5 },  /* 2012 */
+	{ 734909, 0x0ab5,  0 },  /* 2013 */
+	{ 735264, 0x15aa, 10 },  /* 2014 */
+	{ 735648, 0x05d2,  0 },  /* 2015 */
+	{ 736002, 0x0da5,  0 },  /* 2016 */
+	{ 736357, 0x1d4a,  7 },  /* 2017 */
+	{ 736741, 0x0d4a,  0 },  /* 2018 */
+	{ 737095, 0x0c95,  0 },  /* 2019 */
+	{ 737449, 0x152e,  5 },  /* 2020 */
+	{ 737833, 0x0556,  0 },  /* 2021 */
+	{ 738187, 0x0ab5,  0 },  /* 2022 */
+	{ 738542, 0x15b2,  3 },  /* 2023 */
+	{ 738926, 0x06d2,  0 },  /* 2024 */
+	{ 739280, 0x0ea5,  7 },  /* 2025 */
+	{ 739664, 0x0725,  0 },  /* 2026 */
+	{ 740018, 0x064b,  0 },  /* 2027 */
+	{ 740372, 0x0c97,  6 },  /* 2028 */
+	{ 740756, 0x0cab,  0 },  /* 2029 */
+	{ 741111, 0x055a,  0 },  /* 2030 */
+	{ 741465, 0x0ad6,  4 },  /* 2031 */
+	{ 741849, 0x0b69,  0 },  /* 2032 */
+	{ 742204, 0x1752, 12 },  /* 2033 */
+	{ 742588, 0x0b52,  0 },  /* 2034 */
+	{ 742942, 0x0b25,  0 },  /* 2035 */
+	{ 743296, 0x1a4b,  7 },  /* 2036 */
+	{ 743680, 0x0a4b,  0 },  /* 2037 */
+	{ 744034, 0x04ab,  0 },  /* 2038 */
+	{ 744388, 0x055b,  6 },  /* 2039 */
+	{ 744772, 0x05ad,  0 },  /* 2040 */
+	{ 745127, 0x0b6a,  0 },  /* 2041 */
+	{ 745482, 0x1b52,  3 },  /* 2042 */
+	{ 745866, 0x0d92,  0 },  /* 2043 */
+	{ 746220, 0x1d25,  8 },  /* 2044 */
+	{ 746604, 0x0d25,  0 },  /* 2045 */
+	{ 746958, 0x0a55,  0 },  /* 2046 */
+	{ 747312, 0x14ad,  6 },  /* 2047 */
+	{ 747696, 0x04b6,  0 },  /* 2048 */
+	{ 748050, 0x05b5,  0 },  /* 2049 */
+	{ 748405, 0x0daa,  4 },  /* 2050 */
+	{ 748789, 0x0ec9,  0 },  /* 2051 */
+	{ 749144, 0x1e92,  9 },  /* 2052 */
+	{ 749528, 0x0e92,  0 },  /* 2053 */
+	{ 749882, 0x0d26,  0 },  /* 2054 */
+	{ 750236, 0x0a56,  7 },  /* 2055 */
+	{ 750619, 0x0a57,  0 },  /* 2056 */
+	{ 750974, 0x0556,  0 },  /* 2057 */
+	{ 751328, 0x06d5,  5 },  /* 2058 */
+	{ 751712, 0x0755,  0 },  /* 2059 */
+	{ 752067, 0x0749,  0 },  /* 2060 */
+	{ 752421, 0x0e93,  4 },  /* 2061 */
+	{ 752805, 0x0693,  0 },  /* 2062 */
+	{ 753159, 0x152b,  8 },  /* 2063 */
+	{ 753543, 0x052b,  0 },  /* 2064 */
+	{ 753897, 0x0a5b,  0 },  /* 2065 */
+	{ 754252, 0x155a,  6 },  /* 2066 */
+	{ 754636, 0x056a,  0 },  /* 2067 */
+	{ 754990, 0x0b65,  0 },  /* 2068 */
+	{ 755345, 0x174a,  5 },  /* 2069 */
+	{ 755729, 0x0b4a,  0 },  /* 2070 */
+	{ 756083, 0x1a95,  9 },  /* 2071 */
+	{ 756467, 0x0a95,  0 },  /* 2072 */
+	{ 756821, 0x052d,  0 },  /* 2073 */
+	{ 757175, 0x0aad,  7 },  /* 2074 */
+	{ 757559, 0x0ab5,  0 },  /* 2075 */
+	{ 757914, 0x05aa,  0 },  /* 2076 */
+	{ 758268, 0x0ba5,  5 },  /* 2077 */
+	{ 758652, 0x0da5,  0 },  /* 2078 */
+	{ 759007, 0x0d4a,  0 },  /* 2079 */
+	{ 759361, 0x1c95,  4 },  /* 2080 */
+	{ 759745, 0x0c96,  0 },  /* 2081 */
+	{ 760099, 0x194e,  8 },  /* 2082 */
+	{ 760483, 0x0556,  0 },  /* 2083 */
+	{ 760837, 0x0ab5,  0 },  /* 2084 */
+	{ 761192, 0x15b2,  6 },  /* 2085 */
+	{ 761576, 0x06d2,  0 },  /* 2086 */
+	{ 761930, 0x0ea5,  0 },  /* 2087 */
+	{ 762285, 0x0e4a,  5 },  /* 2088 */
+	{ 762668, 0x068b,  0 },  /* 2089 */
+	{ 763022, 0x0c97,  9 },  /* 2090 */
+	{ 763406, 0x04ab,  0 },  /* 2091 */
+	{ 763760, 0x055b,  0 },  /* 2092 */
+	{ 764115, 0x0ad6,  7 },  /* 2093 */
+	{ 764499, 0x0b6a,  0 },  /* 2094 */
+	{ 764854, 0x0752,  0 },  /* 2095 */
+	{ 765208, 0x1725,  5 },  /* 2096 */
+	{ 765592, 0x0b45,  0 },  /* 2097 */
+	{ 765946, 0x0a8b,  0 },  /* 2098 */
+	{ 766300, 0x149b,  3 },  /* 2099 */
+	{ 766684, 0x04ab,  0 },  /* 2100 */
+};
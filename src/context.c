@@ -0,0 +1,122 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2020 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Evaluation contexts; see 'struct cal_context' in calendar.h.
+ */
+
+#include <stdlib.h>
+
+#include "calendar.h"
+#include "dates.h"
+#include "days.h"
+#include "nnames.h"
+#include "utils.h"
+
+static struct cal_context default_context = {
+	.options = {
+		.time = 0.5,  /* noon */
+		.allmode = false,
+		.debug = 0,
+	},
+	.dow_names = default_dow_names,
+	.month_names = default_month_names,
+	.sequence_names = default_sequence_names,
+	.specialdays = default_specialdays,
+};
+
+__thread struct cal_context *cal_ctx = &default_context;
+
+
+/*
+ * Create a new context, with the options and calendar of the current
+ * context, and the names of the current locale.
+ */
+struct cal_context *
+cal_context_new(void)
+{
+	struct cal_context *ctx, *prev;
+
+	ctx = xcalloc(1, sizeof(*ctx));
+	ctx->options = cal_ctx->options;
+	ctx->calendar = cal_ctx->calendar;
+	ctx->dow_names = nnames_dup(default_dow_names);
+	ctx->month_names = nnames_dup(default_month_names);
+	ctx->sequence_names = nnames_dup(default_sequence_names);
+	ctx->specialdays = specialdays_dup();
+
+	prev = cal_context_set(ctx);
+	set_nnames();
+	cal_context_set(prev);
+
+	return ctx;
+}
+
+void
+cal_context_free(struct cal_context *ctx)
+{
+	struct cal_context *prev;
+
+	if (ctx == NULL || ctx == &default_context)
+		return;
+
+	prev = cal_context_set(ctx);
+	free_dates();
+	cal_context_set(prev);
+
+	for (int i = 0; i < ctx->nincluded; i++)
+		free(ctx->included_files[i]);
+	free(ctx->included_files);
+	free(ctx->lang);
+	nnames_free(ctx->dow_names);
+	nnames_free(ctx->month_names);
+	nnames_free(ctx->sequence_names);
+	specialdays_free(ctx->specialdays);
+	free(ctx);
+}
+
+/*
+ * Set the context of the calling thread (NULL for the default one).
+ * Return the previous context.
+ */
+struct cal_context *
+cal_context_set(struct cal_context *ctx)
+{
+	struct cal_context *prev = cal_ctx;
+
+	cal_ctx = (ctx != NULL) ? ctx : &default_context;
+	return prev;
+}
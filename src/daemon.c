@@ -0,0 +1,928 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2019 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Persistent daemon that serves the event queries over a Unix socket,
+ * so that the repeated queries (e.g., from shell prompts and status bars)
+ * do not pay the startup cost of loading the locale, name tables and
+ * astronomical caches every time.
+ *
+ * A query is a sequence of 'key=value' lines terminated by an empty line.
+ * The reply starts with a status line of either 'OK' or 'ERR <message>',
+ * followed by the output of the events.
+ *
+ * Each calendar file is parsed once over a window around the date of the
+ * daemon, and the events are kept resident to serve the queries of any
+ * range within the window; the other queries are evaluated on their own.
+ * The parsed files are also cached per file (see struct cal_cache), so
+ * the system calendar files are shared by the calendar files including
+ * them.  A resident is dropped as soon as any file it depends on changes,
+ * and parsed again from the cache but for the changed file: on Linux the
+ * files and their directories are watched with inotify(7), elsewhere the
+ * file stamps are checked on every lookup.  The queries without an
+ * explicit date use the current date of the daemon, which is rolled
+ * forward at midnight, when all the residents are parsed anew.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#define HAVE_INOTIFY
+#endif
+
+#include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "calendar.h"
+#include "basics.h"
+#include "daemon.h"
+#include "dates.h"
+#include "gregorian.h"
+#include "io.h"
+#include "utils.h"
+
+#define QUERY_MAXLEN	4096	/* maximum length of a query */
+#define QUERY_TIMEOUT	5	/* seconds to wait for a client */
+#define RESIDENT_MAX	16	/* maximum number of resident calendars */
+#define WINDOW_BEFORE	7	/* days parsed before the date of the daemon */
+#define WINDOW_AFTER	31	/* days parsed after the date of the daemon */
+
+struct file_stamp {
+	char		*path;
+	struct timespec	 mtime;
+	off_t		 size;
+};
+
+/*
+ * Calendar file parsed over the window around the date of the daemon,
+ * whose events serve the queries of any range within the window.
+ */
+struct resident {
+	char		*file;  /* NULL if the slot is unused */
+	char		*home;
+	struct location	 location;
+	bool		 dedup;
+	struct cal_context *ctx;  /* context holding the events */
+	struct file_stamp *files;  /* files the events depend on */
+	int		 nfiles;
+	bool		 watched;  /* whether all the files are watched */
+	unsigned long	 used;  /* time of the last use */
+};
+
+/* watched file or directory */
+struct watch {
+	int		 wd;
+	char		*path;
+};
+
+static struct resident residents[RESIDENT_MAX];
+static unsigned long resident_clock = 0;
+static struct cal_cache *cache = NULL;  /* parsed system calendar files */
+
+static struct watch *watches = NULL;
+static int nwatches = 0;
+static int maxwatches = 0;
+static int inotify_fd = -1;
+
+static int today;  /* current date of the daemon */
+static const char *localtz;  /* local time zone, or NULL for the default */
+
+static bool	stamp_set(struct file_stamp *stamp, const char *path);
+static bool	stamp_valid(const struct file_stamp *stamp);
+static bool	is_shared(const char *path);
+static void	resident_invalidate(const char *path, bool name_only);
+static struct resident *resident_get(const struct daemon_query *query,
+				     const char **errmsg);
+static bool	resident_load(struct resident *rp,
+			      const struct daemon_query *query,
+			      const char **errmsg);
+static void	resident_free(struct resident *rp);
+static void	resident_freeall(void);
+static void	watch_init(void);
+static bool	watch_add(const char *path, bool dir);
+static void	watch_read(void);
+static int	get_today(int *timeout);
+static bool	query_parse(char *buf, struct daemon_query *query);
+static int	query_eval(const struct daemon_query *query,
+			   char **output, size_t *len, const char **errmsg);
+static void	handle_client(int fd);
+static bool	read_query(int fd, char *buf, size_t size);
+static bool	write_all(int fd, const char *buf, size_t len);
+
+
+static bool
+stamp_set(struct file_stamp *stamp, const char *path)
+{
+	struct stat sb;
+
+	stamp->path = xstrdup(path);
+	if (stat(path, &sb) == -1) {
+		/* never valid, so the events are loaded again */
+		stamp->size = -1;
+		return false;
+	}
+
+	stamp->mtime = sb.st_mtim;
+	stamp->size = sb.st_size;
+	return true;
+}
+
+static bool
+stamp_valid(const struct file_stamp *stamp)
+{
+	struct stat sb;
+
+	if (stat(stamp->path, &sb) == -1)
+		return false;
+
+	return (sb.st_mtim.tv_sec == stamp->mtime.tv_sec &&
+		sb.st_mtim.tv_nsec == stamp->mtime.tv_nsec &&
+		sb.st_size == stamp->size);
+}
+
+/*
+ * Whether the parsed file $path can be cached for all the residents, which
+ * is true for every file, since they are all read with the privileges of
+ * the daemon.  So the residents depending on a changed file parse only
+ * that file again.
+ */
+static bool
+is_shared(const char *path __unused)
+{
+	return true;
+}
+
+/*
+ * Drop the residents that depend on the file $path, or on any file of
+ * the same name as $path if $name_only is true, and the cached segments
+ * of the file.
+ */
+static void
+resident_invalidate(const char *path, bool name_only)
+{
+	struct resident *rp;
+	const char *name, *p;
+
+	name = (p = strrchr(path, '/')) ? p + 1 : path;
+	for (int i = 0; i < RESIDENT_MAX; i++) {
+		rp = &residents[i];
+		for (int j = 0; j < rp->nfiles; j++) {
+			p = rp->files[j].path;
+			if (name_only) {
+				p = strrchr(p, '/') ? strrchr(p, '/') + 1 : p;
+				if (strcmp(p, name) != 0)
+					continue;
+			} else if (strcmp(p, path) != 0) {
+				continue;
+			}
+			DPRINTF("%s: dropped %s for change of %s\n",
+				__func__, rp->file, path);
+			resident_free(rp);
+			break;
+		}
+	}
+
+	/* no resident uses the segments of the file any more */
+	cal_cache_drop(cache, path);
+}
+
+static void
+watch_init(void)
+{
+#ifdef HAVE_INOTIFY
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1)
+		warn("inotify_init1; fallback to check file stamps");
+#endif
+}
+
+/*
+ * Watch the file (or directory if $dir is true) $path for changes.
+ * The directories are watched so that the files replaced by a rename
+ * (as most editors do) or created to shadow an included file are also
+ * noticed.
+ * Return false if the path cannot be watched (e.g., out of watches).
+ */
+static bool
+watch_add(const char *path, bool dir)
+{
+#ifdef HAVE_INOTIFY
+	uint32_t mask;
+	int wd;
+
+	if (inotify_fd == -1)
+		return false;
+
+	if (dir) {
+		mask = (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+			IN_ONLYDIR);
+	} else {
+		mask = (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+			IN_DELETE_SELF | IN_MOVE_SELF);
+	}
+	if ((wd = inotify_add_watch(inotify_fd, path, mask)) == -1) {
+		DPRINTF("%s: failed to watch %s: %s\n",
+			__func__, path, strerror(errno));
+		return false;
+	}
+
+	for (int i = 0; i < nwatches; i++) {
+		if (watches[i].wd == wd)
+			return true;
+	}
+	if (nwatches == maxwatches) {
+		maxwatches = (maxwatches > 0) ? 2 * maxwatches : 16;
+		watches = xrealloc(watches,
+				   (size_t)maxwatches * sizeof(*watches));
+	}
+	watches[nwatches].wd = wd;
+	watches[nwatches].path = xstrdup(path);
+	nwatches++;
+	return true;
+#else
+	(void)path;
+	(void)dir;
+	return false;
+#endif
+}
+
+/*
+ * Read the pending change events and drop the affected residents.
+ */
+static void
+watch_read(void)
+{
+#ifdef HAVE_INOTIFY
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char path[PATH_MAX];
+	const struct inotify_event *ev;
+	struct watch *w;
+	ssize_t len;
+
+	if (inotify_fd == -1)
+		return;
+
+	while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len;
+		     p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)(void *)p;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				/* events lost; drop everything */
+				resident_freeall();
+				continue;
+			}
+
+			w = NULL;
+			for (int i = 0; i < nwatches; i++) {
+				if (watches[i].wd == ev->wd) {
+					w = &watches[i];
+					break;
+				}
+			}
+			if (w == NULL)
+				continue;
+
+			if (ev->mask & IN_IGNORED) {
+				/* the watch was removed with its file */
+				free(w->path);
+				*w = watches[--nwatches];
+			} else if (ev->len > 0) {
+				snprintf(path, sizeof(path), "%s/%s",
+					 w->path, ev->name);
+				resident_invalidate(path, true);
+			} else {
+				resident_invalidate(w->path, false);
+			}
+		}
+	}
+#endif
+}
+
+/*
+ * Get the resident of the calendar file of the query, which is loaded if
+ * not yet or if any file it depends on has changed since.  Return NULL
+ * on failure with the reason in $errmsg.
+ */
+static struct resident *
+resident_get(const struct daemon_query *query, const char **errmsg)
+{
+	struct resident *rp, *slot = NULL;
+
+	for (int i = 0; i < RESIDENT_MAX; i++) {
+		rp = &residents[i];
+		if (rp->file == NULL ||
+		    strcmp(rp->file, query->file) != 0 ||
+		    strcmp(rp->home, query->home) != 0 ||
+		    memcmp(&rp->location, &query->location,
+			   sizeof(rp->location)) != 0 ||
+		    rp->dedup != query->dedup)
+			continue;
+
+		/* otherwise the watches keep the resident valid */
+		for (int j = 0; !rp->watched && j < rp->nfiles; j++) {
+			if (!stamp_valid(&rp->files[j])) {
+				char path[PATH_MAX];
+
+				/* the stamp is freed with the resident */
+				snprintf(path, sizeof(path), "%s",
+					 rp->files[j].path);
+				DPRINTF("%s: file changed: %s\n",
+					__func__, path);
+				resident_invalidate(path, false);
+				break;
+			}
+		}
+		if (rp->file != NULL) {
+			rp->used = ++resident_clock;
+			return rp;
+		}
+		break;
+	}
+
+	/* replace the least recently used one */
+	for (int i = 0; i < RESIDENT_MAX; i++) {
+		rp = &residents[i];
+		if (rp->file == NULL) {
+			slot = rp;
+			break;
+		}
+		if (slot == NULL || rp->used < slot->used)
+			slot = rp;
+	}
+	resident_free(slot);
+
+	if (!resident_load(slot, query, errmsg))
+		return NULL;
+	slot->used = ++resident_clock;
+	return slot;
+}
+
+/*
+ * Parse the calendar file of the query over the window around the date
+ * of the daemon into the resident $rp, and watch the files it depends on.
+ */
+static bool
+resident_load(struct resident *rp, const struct daemon_query *query,
+	      const char **errmsg)
+{
+	struct cal_context *ctx, *prev;
+	const char *const *included;
+	char home[PATH_MAX];
+	int nincluded;
+	FILE *fp;
+	bool ok;
+
+	/* as the relative paths are cached (see cal_load()) */
+	if (chdir(query->home) == -1 || getcwd(home, sizeof(home)) == NULL) {
+		*errmsg = "cannot enter calendar home";
+		return false;
+	}
+	if ((fp = fopen(query->file, "r")) == NULL) {
+		*errmsg = "cannot open calendar file";
+		return false;
+	}
+
+	rp->file = xstrdup(query->file);
+	rp->home = xstrdup(query->home);
+	rp->location = query->location;
+	rp->dedup = query->dedup;
+
+	rp->ctx = ctx = cal_context_new();
+	ctx->options.location = &rp->location;
+	ctx->options.today = today;
+	ctx->options.day_begin = today - WINDOW_BEFORE;
+	ctx->options.day_end = today + WINDOW_AFTER;
+	ctx->options.dedup = query->dedup;
+	ctx->cache = cache;
+
+	prev = cal_context_set(ctx);
+	generate_dates();
+	ok = cal_load(fp, query->file);
+	nincluded = cal_included_files(&included);
+	cal_context_set(prev);
+	fclose(fp);
+
+	if (!ok) {
+		resident_free(rp);
+		*errmsg = "failed to parse calendar files";
+		return false;
+	}
+
+	/* otherwise the file stamps are checked for each lookup */
+	rp->files = xcalloc((size_t)nincluded + 1, sizeof(*rp->files));
+	rp->watched = stamp_set(&rp->files[rp->nfiles++], query->file);
+	for (int i = 0; i < nincluded; i++) {
+		char path[2 * PATH_MAX];  /* never valid if too long */
+		const char *f = included[i];
+
+		/* the relative paths are against the calendar home */
+		if (f[0] != '/') {
+			if (strncmp(f, "./", 2) == 0)
+				f += 2;
+			snprintf(path, sizeof(path), "%s/%s", home, f);
+			f = path;
+		}
+		if (!stamp_set(&rp->files[rp->nfiles++], f))
+			rp->watched = false;
+	}
+
+	if (!watch_add(home, true))
+		rp->watched = false;
+	for (int i = 0; i < rp->nfiles; i++) {
+		char dir[PATH_MAX], *p;
+
+		if (!watch_add(rp->files[i].path, false))
+			rp->watched = false;
+		snprintf(dir, sizeof(dir), "%s", rp->files[i].path);
+		if ((p = strrchr(dir, '/')) != NULL) {
+			*p = '\0';
+			if (!watch_add(dir, true))
+				rp->watched = false;
+		}
+	}
+
+	DPRINTF("%s: loaded %s (%d files)\n", __func__, rp->file, rp->nfiles);
+	return true;
+}
+
+static void
+resident_free(struct resident *rp)
+{
+	struct cal_context *prev;
+
+	if (rp->ctx != NULL) {
+		prev = cal_context_set(rp->ctx);
+		cal_unload();
+		cal_context_set(prev);
+		cal_context_free(rp->ctx);
+	}
+	for (int i = 0; i < rp->nfiles; i++)
+		free(rp->files[i].path);
+	free(rp->files);
+	free(rp->file);
+	free(rp->home);
+	memset(rp, 0, sizeof(*rp));
+}
+
+/*
+ * Drop all the residents and the cached files, e.g., for a new date.
+ */
+static void
+resident_freeall(void)
+{
+	for (int i = 0; i < RESIDENT_MAX; i++)
+		resident_free(&residents[i]);
+	cal_cache_drop(cache, NULL);
+}
+
+/*
+ * Parse the query in $buf (modified in place) into $query.
+ */
+static bool
+query_parse(char *buf, struct daemon_query *query)
+{
+	char *line, *value, *endp;
+	double *dp;
+
+	memset(query, 0, sizeof(*query));
+	query->days_before = query->days_after = INT_MIN;
+
+	while ((line = strsep(&buf, "\n")) != NULL && *line != '\0') {
+		if ((value = strchr(line, '=')) == NULL)
+			return false;
+		*value++ = '\0';
+
+		if (strcmp(line, "file") == 0) {
+			query->file = value;
+			continue;
+		} else if (strcmp(line, "home") == 0) {
+			query->home = value;
+			continue;
+		} else if (strcmp(line, "dedup") == 0) {
+			query->dedup = (strcmp(value, "1") == 0);
+			continue;
+		}
+
+		dp = NULL;
+		if (strcmp(line, "latitude") == 0)
+			dp = &query->location.latitude;
+		else if (strcmp(line, "longitude") == 0)
+			dp = &query->location.longitude;
+		else if (strcmp(line, "elevation") == 0)
+			dp = &query->location.elevation;
+		else if (strcmp(line, "zone") == 0)
+			dp = &query->location.zone;
+		if (dp != NULL) {
+			*dp = strtod(value, &endp);
+			if (endp == value || *endp != '\0')
+				return false;
+			continue;
+		}
+
+		long v = strtol(value, &endp, 10);
+		if (endp == value || *endp != '\0')
+			return false;
+		if (strcmp(line, "today") == 0) {
+			query->today = (int)v;
+			query->today_set = true;
+		} else if (strcmp(line, "before") == 0)
+			query->days_before = (int)v;
+		else if (strcmp(line, "after") == 0)
+			query->days_after = (int)v;
+		else if (strcmp(line, "output") == 0)
+			query->output = (int)v;
+		else
+			return false;
+	}
+
+	return (query->file != NULL && query->file[0] == '/' &&
+		query->home != NULL && query->home[0] == '/' &&
+		query->days_before >= 0 && query->days_after >= 0 &&
+		(query->output == OUTPUT_TEXT ||
+		 query->output == OUTPUT_JSON ||
+		 query->output == OUTPUT_ICS));
+}
+
+/*
+ * Evaluate the query and return the output in $output, which should be
+ * freed by the caller.  The ranges within the window around the date of
+ * the daemon are printed from the resident events of the calendar file,
+ * and the others are evaluated on their own.
+ */
+static int
+query_eval(const struct daemon_query *query,
+	   char **output, size_t *len, const char **errmsg)
+{
+	struct resident *rp;
+	struct cal_context *prev;
+	FILE *fpin, *fpout;
+	int rd, ret;
+
+	rd = query->today_set ? query->today : today;
+	if (rd == today &&
+	    query->days_before <= WINDOW_BEFORE &&
+	    query->days_after <= WINDOW_AFTER) {
+		if ((rp = resident_get(query, errmsg)) == NULL)
+			return 1;
+		if ((fpout = open_memstream(output, len)) == NULL) {
+			*errmsg = "out of memory";
+			return 1;
+		}
+		prev = cal_context_set(rp->ctx);
+		Options.output = query->output;
+		event_print_range(fpout, today - query->days_before,
+				  today + query->days_after);
+		cal_context_set(prev);
+		fclose(fpout);
+		return 0;
+	}
+
+	if (chdir(query->home) == -1) {
+		*errmsg = "cannot enter calendar home";
+		return 1;
+	}
+	if ((fpin = fopen(query->file, "r")) == NULL) {
+		*errmsg = "cannot open calendar file";
+		return 1;
+	}
+	if ((fpout = open_memstream(output, len)) == NULL) {
+		fclose(fpin);
+		*errmsg = "out of memory";
+		return 1;
+	}
+
+	Options.today = rd;
+	Options.day_begin = Options.today - query->days_before;
+	Options.day_end = Options.today + query->days_after;
+	Options.output = query->output;
+	Options.dedup = query->dedup;
+	*Options.location = query->location;
+
+	generate_dates();
+	ret = cal_print(fpin, fpout);
+	free_dates();
+	cal_reset();
+
+	fclose(fpout);
+	fclose(fpin);
+
+	if (ret != 0) {
+		free(*output);
+		*output = NULL;
+		*errmsg = "failed to parse calendar files";
+	}
+	return ret;
+}
+
+/*
+ * Get the current date of the daemon, and the milliseconds until the
+ * next midnight in $timeout.
+ */
+static int
+get_today(int *timeout)
+{
+	struct date gdate;
+	struct tm tm;
+	time_t now;
+
+	/* the process is in UTC; switch to the local time zone briefly */
+	if (localtz != NULL)
+		setenv("TZ", localtz, 1);
+	else
+		unsetenv("TZ");
+	tzset();
+	now = time(NULL);
+	localtime_r(&now, &tm);
+	setenv("TZ", "UTC", 1);
+	tzset();
+
+	*timeout = (24 * 3600 - (tm.tm_hour * 3600 + tm.tm_min * 60 +
+				 tm.tm_sec)) * 1000;
+	date_set(&gdate, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+	return fixed_from_gregorian(&gdate);
+}
+
+static bool
+read_query(int fd, char *buf, size_t size)
+{
+	size_t n = 0;
+	ssize_t r;
+
+	while (n < size - 1) {
+		r = read(fd, buf + n, size - 1 - n);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return false;
+		n += (size_t)r;
+		buf[n] = '\0';
+		if (strstr(buf, "\n\n") != NULL)
+			return true;
+	}
+
+	return false;
+}
+
+static bool
+write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t r;
+
+	while (len > 0) {
+		r = write(fd, buf, len);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r == -1)
+			return false;
+		buf += r;
+		len -= (size_t)r;
+	}
+
+	return true;
+}
+
+static void
+handle_client(int fd)
+{
+	struct daemon_query query;
+	struct timeval tv = { QUERY_TIMEOUT, 0 };
+	char buf[QUERY_MAXLEN], status[128];
+	char *output = NULL;
+	size_t len = 0;
+	const char *errmsg = NULL;
+
+	/* do not let a stalled client block the others */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	if (!read_query(fd, buf, sizeof(buf))) {
+		errmsg = "invalid query";
+		goto out;
+	}
+	*(strstr(buf, "\n\n") + 1) = '\0';
+
+	watch_read();  /* catch up the changes before the lookup */
+
+	if (!query_parse(buf, &query)) {
+		errmsg = "invalid query";
+		goto out;
+	}
+	if (query_eval(&query, &output, &len, &errmsg) != 0)
+		goto out;
+
+	if (write_all(fd, "OK\n", 3))
+		write_all(fd, output, len);
+	free(output);
+	return;
+
+out:
+	snprintf(status, sizeof(status), "ERR %s\n", errmsg);
+	write_all(fd, status, strlen(status));
+}
+
+/*
+ * Serve the queries on the Unix socket $path forever.  The date of the
+ * daemon follows the local time zone $tz (the original value of 'TZ').
+ */
+int
+daemon_serve(const char *path, const char *tz)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat sb;
+	struct pollfd pfds[2];
+	mode_t mask;
+	int sock, fd, rd, timeout;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		errx(1, "socket path too long: '%s'", path);
+	strcpy(addr.sun_path, path);
+
+	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+		err(1, "signal");
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+
+	/* remove the stale socket left by a previous daemon */
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+		unlink(path);
+
+	/* only the owner can connect */
+	mask = umask(077);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		err(1, "bind(%s)", path);
+	umask(mask);
+
+	if (listen(sock, 16) == -1)
+		err(1, "listen");
+
+	localtz = tz;
+	today = get_today(&timeout);
+	cache = cal_cache_new(is_shared);
+	watch_init();
+
+	pfds[0].fd = sock;
+	pfds[0].events = POLLIN;
+	pfds[1].fd = inotify_fd;
+	pfds[1].events = POLLIN;
+
+	for (;;) {
+		pfds[0].revents = pfds[1].revents = 0;
+		if (poll(pfds, (inotify_fd != -1) ? 2 : 1, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "poll");
+		}
+
+		/* midnight: roll the date forward */
+		if ((rd = get_today(&timeout)) != today) {
+			DPRINTF("%s: new day: %d -> %d\n", __func__,
+				today, rd);
+			today = Options.today = rd;
+			resident_freeall();
+		}
+
+		if (pfds[1].revents & POLLIN)
+			watch_read();
+		if ((pfds[0].revents & POLLIN) == 0)
+			continue;
+
+		if ((fd = accept(sock, NULL, NULL)) == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			err(1, "accept");
+		}
+		handle_client(fd);
+		close(fd);
+	}
+}
+
+/*
+ * Send the query to the daemon on the Unix socket $path, and print the
+ * reply to stdout.
+ */
+int
+daemon_query(const char *path, const struct daemon_query *query)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	char buf[QUERY_MAXLEN];
+	char *p;
+	int sock, n;
+	ssize_t r;
+	size_t len;
+	bool status = false;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		errx(1, "socket path too long: '%s'", path);
+	strcpy(addr.sun_path, path);
+
+	if (strchr(query->file, '\n') != NULL ||
+	    strchr(query->home, '\n') != NULL)
+		errx(1, "invalid path with a newline");
+	n = snprintf(buf, sizeof(buf),
+		     "file=%s\nhome=%s\nbefore=%d\nafter=%d\n"
+		     "latitude=%.17g\nlongitude=%.17g\nelevation=%.17g\n"
+		     "zone=%.17g\noutput=%d\ndedup=%d\n",
+		     query->file, query->home,
+		     query->days_before, query->days_after,
+		     query->location.latitude, query->location.longitude,
+		     query->location.elevation, query->location.zone,
+		     query->output, query->dedup ? 1 : 0);
+	if (n > 0 && (size_t)n < sizeof(buf) && query->today_set) {
+		n += snprintf(buf + n, sizeof(buf) - (size_t)n, "today=%d\n",
+			      query->today);
+	}
+	if (n > 0 && (size_t)n < sizeof(buf) - 1) {
+		buf[n++] = '\n';  /* end of query */
+		buf[n] = '\0';
+	}
+	if (n < 0 || (size_t)n >= sizeof(buf))
+		errx(1, "query too long");
+
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		err(1, "connect(%s)", path);
+	if (!write_all(sock, buf, (size_t)n))
+		err(1, "write");
+	shutdown(sock, SHUT_WR);
+
+	len = 0;
+	while ((r = read(sock, buf + len, sizeof(buf) - 1 - len)) != 0) {
+		if (r == -1) {
+			if (errno == EINTR)
+				continue;
+			err(1, "read");
+		}
+		len += (size_t)r;
+		if (!status) {
+			buf[len] = '\0';
+			if ((p = strchr(buf, '\n')) == NULL) {
+				if (len == sizeof(buf) - 1)
+					errx(1, "invalid reply");
+				continue;
+			}
+			*p++ = '\0';
+			if (strcmp(buf, "OK") != 0) {
+				warnx("daemon: %s", (strncmp(buf, "ERR ", 4)
+					== 0) ? buf + 4 : buf);
+				close(sock);
+				return 1;
+			}
+			status = true;
+			len -= (size_t)(p - buf);
+			memmove(buf, p, len);
+		}
+		fwrite(buf, 1, len, stdout);
+		len = 0;
+	}
+	close(sock);
+
+	if (!status)
+		errx(1, "no reply from daemon");
+	return 0;
+}
@@ -33,10 +33,15 @@
  */
 
 #include <assert.h>
+#include <inttypes.h>
+#include <pwd.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "calendar.h"
 #include "basics.h"
@@ -46,190 +51,764 @@
 #include "utils.h"
 
 
-struct event {
-	bool		 variable;  /* Whether a variable event ? */
+/*
+ * Date strings of a day, formatted once and shared by the events added
+ * with the same locale, date order and calendar.
+ */
+struct day_format {
+	int		 locale;  /* Locale generation */
+	bool		 day_first;  /* Whether day before month ? */
+	const struct calendar *calendar;  /* User-chosen calendar */
 	char		 date[32];  /* Date in Gregorian calendar */
 	char		 date_user[64];  /* Date in user-chosen calendar */
+	struct day_format *next;
+};
+
+struct event {
+	bool		 variable;  /* Whether a variable event ? */
+	const struct day_format *format;  /* Formatted dates of the day */
 	struct cal_desc *description;  /* Event description */
 	char		*extra;  /* Extra data of the event */
-	struct event	*next;
 };
 
-static struct cal_day *cal_days = NULL;
+/*
+ * The days in the range are stored in pages, which are only allocated
+ * when a day of the page is looked up by find_rd(), i.e., when events
+ * may be added to it.  So the memory scales with the events rather than
+ * with the range.
+ */
+#define DAYS_PER_PAGE	64
 
+/*
+ * Slot of the hash table of the added events (in the context) for the
+ * duplicate suppression, with open addressing and linear probing.
+ */
+struct event_slot {
+	struct cal_day	*dp;  /* NULL if the slot is empty */
+	int		 index;  /* index of the event in $dp->events */
+};
 
-void
-generate_dates(void)
+
+/*
+ * Set up the day $dp of fixed date $rd.
+ */
+static void
+day_init(struct cal_day *dp, int rd)
 {
-	struct cal_day *dp;
 	struct date date;
-	int daycount, dow, year, month, day;
-	int rd_month1, rd_nextmonth, rd_nextyear;
-
-	daycount = Options.day_end - Options.day_begin + 1;
-	cal_days = xcalloc((size_t)daycount, sizeof(struct cal_day));
+	int rd_nextmonth;
 
-	dow = dayofweek_from_fixed(Options.day_begin);
-	gregorian_from_fixed(Options.day_begin, &date);
-	year = date.year;
-	month = date.month;
-	day = date.day;
+	gregorian_from_fixed(rd, &date);
+	dp->rd = rd;
+	dp->year = date.year;
+	dp->month = date.month;
+	dp->day = date.day;
 
-	date.day = 1;
-	rd_month1 = fixed_from_gregorian(&date);
-	if (date.month == 12) {
-		date_set(&date, date.year+1, 1, 1);
-		rd_nextmonth = fixed_from_gregorian(&date);
-		rd_nextyear = rd_nextmonth;
-	} else {
-		date.month++;
-		rd_nextmonth = fixed_from_gregorian(&date);
+	if (date.month == 12)
 		date_set(&date, date.year+1, 1, 1);
-		rd_nextyear = fixed_from_gregorian(&date);
-	}
+	else
+		date_set(&date, date.year, date.month+1, 1);
+	rd_nextmonth = fixed_from_gregorian(&date);
 
-	for (int i = 0; i < daycount; i++) {
-		dp = &cal_days[i];
-		dp->rd = Options.day_begin + i;
+	dp->dow[0] = dayofweek_from_fixed(rd);
+	dp->dow[1] = (dp->day - 1) / 7 + 1;
+	dp->dow[2] = -((rd_nextmonth - rd - 1) / 7 + 1);
+	dp->last_dom = (rd == rd_nextmonth - 1);
+}
 
-		if (dp->rd == rd_nextmonth) {
-			month++;
-			day = 1;
-			rd_month1 = rd_nextmonth;
-			if (dp->rd == rd_nextyear) {
-				year++;
-				month = 1;
-			}
+void
+generate_dates(void)
+{
+	int daycount;
 
-			date_set(&date, year, month, day);
-			if (date.month == 12) {
-				date_set(&date, date.year+1, 1, 1);
-				rd_nextmonth = fixed_from_gregorian(&date);
-				rd_nextyear = rd_nextmonth;
-			} else {
-				date.month++;
-				rd_nextmonth = fixed_from_gregorian(&date);
-				date_set(&date, date.year+1, 1, 1);
-				rd_nextyear = fixed_from_gregorian(&date);
-			}
-		}
+	daycount = Options.day_end - Options.day_begin + 1;
+	cal_ctx->npages = (daycount + DAYS_PER_PAGE - 1) / DAYS_PER_PAGE;
+	cal_ctx->day_pages = xcalloc((size_t)cal_ctx->npages,
+				     sizeof(*cal_ctx->day_pages));
+}
+
+/*
+ * Iterate over the allocated days (NULL to start), i.e., the days that
+ * may have events.
+ */
+static struct cal_day *
+loop_pages(struct cal_day *dp)
+{
+	int i, n;
 
-		dp->year = year;
-		dp->month = month;
-		dp->day = dp->rd - rd_month1 + 1;
-		dp->dow[0] = (dow + i) % 7;
-		dp->dow[1] = (dp->rd - rd_month1) / 7 + 1;
-		dp->dow[2] = -((rd_nextmonth - dp->rd - 1) / 7 + 1);
-		dp->last_dom = (dp->rd == rd_nextmonth - 1);
+	if (dp == NULL) {
+		i = 0;
+	} else {
+		if (dp->rd >= Options.day_end)
+			return NULL;
+		n = dp->rd - Options.day_begin;
+		if ((n + 1) % DAYS_PER_PAGE != 0)
+			return dp + 1;
+		i = (n + 1) / DAYS_PER_PAGE;
+	}
 
-		DPRINTF("%s: [%d] rd:%d, date:%d-%02d-%02d, dow:[%d,%d,%d]\n",
-			__func__, i, dp->rd, dp->year, dp->month,
-			dp->day, dp->dow[0], dp->dow[1], dp->dow[2]);
+	for (; i < cal_ctx->npages; i++) {
+		if (cal_ctx->day_pages[i] != NULL)
+			return cal_ctx->day_pages[i];
 	}
+	return NULL;
 }
 
 void
 free_dates(void)
 {
-	struct event *e;
+	struct cal_context *ctx = cal_ctx;
+	struct day_format *df;
 	struct cal_day *dp = NULL;
 
-	while ((dp = loop_dates(dp)) != NULL) {
-		while ((e = dp->events) != NULL) {
-			dp->events = e->next;
-			free(e->extra);
-			free(e);
+	while ((dp = loop_pages(dp)) != NULL) {
+		for (int i = 0; i < dp->nevents; i++)
+			free(dp->events[i].extra);
+		free(dp->events);
+		while ((df = dp->formats) != NULL) {
+			dp->formats = df->next;
+			free(df);
 		}
 	}
-	free(cal_days);
+	for (int i = 0; i < ctx->npages; i++)
+		free(ctx->day_pages[i]);
+	free(ctx->day_pages);
+	ctx->day_pages = NULL;
+	ctx->npages = 0;
+	free(ctx->event_slots);
+	ctx->event_slots = NULL;
+	ctx->event_size = ctx->event_count = 0;
 }
 
+/*
+ * Iterate over all the days in the range (NULL to start).  The returned
+ * day is computed on demand and only valid until the next call; use
+ * find_rd() to get the day to add events to.
+ */
 struct cal_day *
 loop_dates(struct cal_day *dp)
 {
-	int daycount = Options.day_end - Options.day_begin + 1;
+	static __thread struct cal_day day;
+	int rd;
 
-	if (dp == NULL)
-		dp = &cal_days[0];
-	else
-		dp++;
-
-	if (dp < &cal_days[0] || dp > &cal_days[daycount-1])
+	rd = (dp == NULL) ? Options.day_begin : dp->rd + 1;
+	if (rd < Options.day_begin || rd > Options.day_end)
 		return NULL;
-	else
-		return dp;
+
+	day_init(&day, rd);
+	return &day;
 }
 
 
+/*
+ * Get the day of fixed date ($rd + $offset), which is allocated (together
+ * with its page) on demand.  Return NULL if the day is out of range.
+ */
 struct cal_day *
 find_rd(int rd, int offset)
 {
+	struct cal_day *page;
+	int n, first;
+
 	rd += offset;
 	if (rd < Options.day_begin || rd > Options.day_end)
 		return NULL;
 
-	return &cal_days[rd - Options.day_begin];
+	n = rd - Options.day_begin;
+	page = cal_ctx->day_pages[n / DAYS_PER_PAGE];
+	if (page == NULL) {
+		page = xcalloc(DAYS_PER_PAGE, sizeof(*page));
+		first = rd - n % DAYS_PER_PAGE;
+		for (int i = 0; i < DAYS_PER_PAGE; i++) {
+			if (first + i > Options.day_end)
+				break;
+			day_init(&page[i], first + i);
+		}
+		cal_ctx->day_pages[n / DAYS_PER_PAGE] = page;
+	}
+
+	return &page[n % DAYS_PER_PAGE];
 }
 
+/*
+ * Tell that the locale has been changed, so that the dates of the
+ * following events are formatted anew.
+ */
+void
+event_locale_changed(void)
+{
+	cal_ctx->locale_generation++;
+}
 
-struct event *
-event_add(struct cal_day *dp, bool day_first, bool variable,
-	  struct cal_desc *desc, char *extra)
+/*
+ * Get the date strings of day $dp in the current locale and calendar,
+ * which are formatted only for the first event of the day.
+ */
+static const struct day_format *
+day_format_get(struct cal_day *dp, bool day_first)
 {
-	struct event *e;
-	struct date gdate;
+	struct day_format *df;
 	struct tm tm = { 0 };
 
-	e = xcalloc(1, sizeof(*e));
+	for (df = dp->formats; df != NULL; df = df->next) {
+		if (df->locale == cal_ctx->locale_generation &&
+		    df->day_first == day_first &&
+		    df->calendar == Calendar)
+			return df;
+	}
+
+	df = xcalloc(1, sizeof(*df));
+	df->locale = cal_ctx->locale_generation;
+	df->day_first = day_first;
+	df->calendar = Calendar;
 
-	gregorian_from_fixed(dp->rd, &gdate);
-	tm.tm_year = gdate.year - 1900;
-	tm.tm_mon = gdate.month - 1;
-	tm.tm_mday = gdate.day;
-	strftime(e->date, sizeof(e->date),
+	tm.tm_year = dp->year - 1900;
+	tm.tm_mon = dp->month - 1;
+	tm.tm_mday = dp->day;
+	strftime(df->date, sizeof(df->date),
 		 (day_first ? "%e %b" : "%b %e"), &tm);
 	if (Calendar->format_date != NULL) {
-		(Calendar->format_date)(e->date_user, sizeof(e->date_user),
+		(Calendar->format_date)(df->date_user, sizeof(df->date_user),
 					dp->rd);
 	}
 
-	e->variable = variable;
-	e->description = desc;
-	if (extra != NULL && extra[0] != '\0')
-		e->extra = extra;
+	df->next = dp->formats;
+	dp->formats = df;
+
+	return df;
+}
+
+/*
+ * FNV-1a hash of the string $str, continuing from $hash.
+ */
+static uint32_t
+hash_string(uint32_t hash, const char *str)
+{
+	for (; *str != '\0'; str++) {
+		hash ^= (unsigned char)*str;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ * Hash the key of the event $e of day $dp: the date, the first line of
+ * the description and the extra data.
+ */
+static uint32_t
+event_hash(const struct cal_day *dp, const struct event *e)
+{
+	uint32_t hash = 2166136261U ^ (uint32_t)dp->rd;
+
+	hash *= 16777619U;
+	hash = hash_string(hash, e->description->firstline->str);
+	if (e->extra != NULL)
+		hash = hash_string(hash ^ 0xFF, e->extra);
+	return hash;
+}
+
+/*
+ * Return true if the events $e1 and $e2 of the same day would print
+ * exactly the same.
+ */
+static bool
+event_equal(const struct event *e1, const struct event *e2)
+{
+	const struct cal_line *l1, *l2;
+
+	if (e1->variable != e2->variable)
+		return false;
+	if (e1->format != e2->format &&
+	    (strcmp(e1->format->date, e2->format->date) != 0 ||
+	     strcmp(e1->format->date_user, e2->format->date_user) != 0))
+		return false;
+	if ((e1->extra == NULL) != (e2->extra == NULL) ||
+	    (e1->extra != NULL && strcmp(e1->extra, e2->extra) != 0))
+		return false;
+
+	if (e1->description == e2->description)
+		return true;
+	for (l1 = e1->description->firstline, l2 = e2->description->firstline;
+	     l1 != NULL && l2 != NULL;
+	     l1 = l1->next, l2 = l2->next) {
+		if (strcmp(l1->str, l2->str) != 0)
+			return false;
+	}
+	return (l1 == NULL && l2 == NULL);
+}
+
+/*
+ * Look up the event $e of day $dp in the hash table.  Return true if a
+ * duplicate exists, otherwise insert $e as the $index-th event of the
+ * day and return false.
+ */
+static bool
+event_table_check(struct cal_day *dp, const struct event *e, int index)
+{
+	struct cal_context *ctx = cal_ctx;
+	struct event_slot *slots, *slot;
+	size_t size, i;
+
+	if (2 * (ctx->event_count + 1) > ctx->event_size) {
+		/* grow to keep the load factor below 1/2 */
+		size = (ctx->event_size > 0) ? 2 * ctx->event_size : 256;
+		slots = xcalloc(size, sizeof(*slots));
+		for (size_t k = 0; k < ctx->event_size; k++) {
+			slot = &ctx->event_slots[k];
+			if (slot->dp == NULL)
+				continue;
+			i = event_hash(slot->dp, &slot->dp->events[slot->index]);
+			while (slots[i & (size - 1)].dp != NULL)
+				i++;
+			slots[i & (size - 1)] = *slot;
+		}
+		free(ctx->event_slots);
+		ctx->event_slots = slots;
+		ctx->event_size = size;
+	}
+
+	for (i = event_hash(dp, e); ; i++) {
+		slot = &ctx->event_slots[i & (ctx->event_size - 1)];
+		if (slot->dp == NULL)
+			break;
+		if (slot->dp == dp && event_equal(&dp->events[slot->index], e))
+			return true;
+	}
+
+	slot->dp = dp;
+	slot->index = index;
+	ctx->event_count++;
+	return false;
+}
+
+/*
+ * Append an event to the day $dp, keeping the events of a day in the
+ * order they are added, i.e., in the order of the calendar files.
+ * If Options.dedup is set, an event that would print exactly the same
+ * as an earlier event of the day is dropped.
+ */
+void
+event_add(struct cal_day *dp, bool day_first, bool variable,
+	  struct cal_desc *desc, char *extra)
+{
+	struct event ev;
+
+	ev.format = day_format_get(dp, day_first);
+	ev.variable = variable;
+	ev.description = desc;
+	if (extra != NULL && extra[0] != '\0') {
+		ev.extra = extra;
+	} else {
+		ev.extra = NULL;
+		free(extra);
+	}
+
+	if (Options.dedup && event_table_check(dp, &ev, dp->nevents)) {
+		DPRINTF2("%s: drop duplicate event |%s|\n",
+			 __func__, desc->firstline->str);
+		free(ev.extra);
+		return;
+	}
+
+	if (dp->nevents == dp->maxevents) {
+		dp->maxevents = (dp->maxevents > 0) ? 2 * dp->maxevents : 4;
+		dp->events = xrealloc(dp->events,
+				      (size_t)dp->maxevents * sizeof(ev));
+	}
+	dp->events[dp->nevents++] = ev;
+}
+
+/*
+ * Print the event $e in the default text format.
+ */
+static void
+event_print_text(FILE *fp, const struct event *e)
+{
+	const struct cal_desc *desc = e->description;
+	const struct cal_line *line;
+
+	fputs(e->format->date, fp);
+	fputc(e->variable ? '*' : ' ', fp);
+	fputc('\t', fp);
+	if (e->format->date_user[0] != '\0')
+		fprintf(fp, "[%s] ", e->format->date_user);
+
+	for (line = desc->firstline; line; line = line->next) {
+		if (line != desc->firstline)
+			fputs("\t\t", fp);
+		fputs(line->str, fp);
+		if (line != desc->lastline)
+			fputc('\n', fp);
+	}
+	if (e->extra)
+		fprintf(fp, " (%s)", e->extra);
+
+	fputc('\n', fp);
+}
+
+/*
+ * Print the string $s as a JSON string, or 'null' if $s is NULL.
+ */
+static void
+json_print_string(FILE *fp, const char *s)
+{
+	unsigned char ch;
+
+	if (s == NULL) {
+		fputs("null", fp);
+		return;
+	}
 
-	e->next = dp->events;
-	dp->events = e;
+	fputc('"', fp);
+	for (; (ch = (unsigned char)*s) != '\0'; s++) {
+		switch (ch) {
+		case '"':
+		case '\\':
+			fputc('\\', fp);
+			fputc(ch, fp);
+			break;
+		case '\n':
+			fputs("\\n", fp);
+			break;
+		case '\t':
+			fputs("\\t", fp);
+			break;
+		default:
+			if (ch < 0x20)
+				fprintf(fp, "\\u%04x", ch);
+			else
+				fputc(ch, fp);
+		}
+	}
+	fputc('"', fp);
+}
 
-	return (e);
+/*
+ * Print the event $e of day $dp as a JSON object in a line.
+ */
+static void
+event_print_json(FILE *fp, const struct cal_day *dp, const struct event *e)
+{
+	const struct cal_line *line;
+
+	fprintf(fp, "{\"rd\":%d,\"date\":\"%04d-%02d-%02d\",\"variable\":%s,",
+		dp->rd, dp->year, dp->month, dp->day,
+		e->variable ? "true" : "false");
+	fputs("\"date_user\":", fp);
+	json_print_string(fp, (e->format->date_user[0] != '\0') ?
+			  e->format->date_user : NULL);
+	fputs(",\"description\":[", fp);
+	for (line = e->description->firstline; line; line = line->next) {
+		if (line != e->description->firstline)
+			fputc(',', fp);
+		json_print_string(fp, line->str);
+	}
+	fputs("],\"extra\":", fp);
+	json_print_string(fp, e->extra);
+	fputs("}\n", fp);
 }
 
+/* maximum octets of an iCalendar content line, excluding the CRLF */
+#define ICS_LINE_MAX	75
+
+/*
+ * Writer of iCalendar content lines, which folds the long lines.
+ * Ref: RFC 5545, Sec.(3.1)
+ */
+struct ics_writer {
+	FILE	*fp;
+	int	col;  /* octets in the current line */
+};
+
+/*
+ * Properties shared by the VEVENTs of an iCalendar output.
+ */
+struct ics_stamp {
+	char		dtstamp[32];  /* creation time of the output */
+	char		host[256];  /* domain part of the UIDs */
+	uint64_t	seed;  /* hash of the user, to tell apart the UIDs */
+};
+
+static void
+ics_putc(struct ics_writer *w, unsigned char ch)
+{
+	int len;
+
+	/* fold before a character, but not inside a UTF-8 sequence */
+	if ((ch & 0xC0) != 0x80) {
+		if (ch >= 0xF0)
+			len = 4;
+		else if (ch >= 0xE0)
+			len = 3;
+		else if (ch >= 0xC0)
+			len = 2;
+		else
+			len = 1;
+		if (w->col + len > ICS_LINE_MAX) {
+			fputs("\r\n ", w->fp);
+			w->col = 1;
+		}
+	}
+	fputc(ch, w->fp);
+	w->col++;
+}
+
+static void
+ics_puts(struct ics_writer *w, const char *s)
+{
+	for (; *s != '\0'; s++)
+		ics_putc(w, (unsigned char)*s);
+}
+
+/*
+ * Write the string $s as an iCalendar TEXT value.
+ * Ref: RFC 5545, Sec.(3.3.11)
+ */
+static void
+ics_put_text(struct ics_writer *w, const char *s)
+{
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '\\':
+		case ';':
+		case ',':
+			ics_putc(w, '\\');
+			ics_putc(w, (unsigned char)*s);
+			break;
+		case '\n':
+			ics_puts(w, "\\n");
+			break;
+		default:
+			ics_putc(w, (unsigned char)*s);
+		}
+	}
+}
+
+static void
+ics_end_line(struct ics_writer *w)
+{
+	fputs("\r\n", w->fp);
+	w->col = 0;
+}
+
+/*
+ * 64-bit FNV-1a hash of the string $str (including the terminating NUL,
+ * to separate the concatenated strings), continuing from $hash.
+ */
+static uint64_t
+hash64_string(uint64_t hash, const char *str)
+{
+	do {
+		hash ^= (unsigned char)*str;
+		hash *= 1099511628211ULL;
+	} while (*str++ != '\0');
+	return hash;
+}
+
+static void
+ics_stamp_init(struct ics_stamp *stamp)
+{
+	const char *user = cal_ctx->mail_user;
+	struct passwd *pw;
+	struct tm tm;
+	time_t now;
+
+	now = time(NULL);
+	gmtime_r(&now, &tm);
+	strftime(stamp->dtstamp, sizeof(stamp->dtstamp),
+		 "%Y%m%dT%H%M%SZ", &tm);
+
+	if (gethostname(stamp->host, sizeof(stamp->host)) == -1 ||
+	    stamp->host[0] == '\0')
+		snprintf(stamp->host, sizeof(stamp->host), "calendar");
+	stamp->host[sizeof(stamp->host) - 1] = '\0';
+
+	if (user == NULL && (pw = getpwuid(getuid())) != NULL)
+		user = pw->pw_name;
+	stamp->seed = hash64_string(14695981039346656037ULL,
+				    user ? user : "");
+}
+
+/*
+ * Hash the event $e of day $dp, i.e., the date and the whole text, into
+ * the unique part of its UID.
+ */
+static uint64_t
+event_hash_ics(const struct cal_day *dp, const struct event *e,
+	       uint64_t seed)
+{
+	const struct cal_line *line;
+	char buf[16];
+
+	snprintf(buf, sizeof(buf), "%d", dp->rd);
+	seed = hash64_string(seed, buf);
+	for (line = e->description->firstline; line; line = line->next)
+		seed = hash64_string(seed, line->str);
+	if (e->extra != NULL)
+		seed = hash64_string(seed ^ 0xFF, e->extra);
+	return seed;
+}
+
+/* UID of an iCalendar event */
+struct ics_uid {
+	uint64_t	hash;  /* hash of the date, event text and user */
+	int		idx;  /* index of the event in the day */
+	int		dup;  /* number of the same events before it */
+};
+
+static int
+ics_uid_cmp(const void *a, const void *b)
+{
+	const struct ics_uid *ua = a, *ub = b;
+
+	if (ua->hash != ub->hash)
+		return (ua->hash > ub->hash) ? 1 : -1;
+	return ua->idx - ub->idx;
+}
+
+/*
+ * Set the UIDs of the events of day $dp into $uids (indexed by event):
+ * the same events get increasing $dup in their order of the day.
+ * $tmp is scratch space of the same size.
+ */
+static void
+ics_uids_set(const struct cal_day *dp, const struct ics_stamp *stamp,
+	     struct ics_uid *uids, struct ics_uid *tmp)
+{
+	int n = dp->nevents;
+
+	for (int i = 0; i < n; i++) {
+		tmp[i].hash = event_hash_ics(dp, &dp->events[i], stamp->seed);
+		tmp[i].idx = i;
+		tmp[i].dup = 0;
+	}
+	qsort(tmp, (size_t)n, sizeof(*tmp), ics_uid_cmp);
+	for (int i = 1; i < n; i++) {
+		if (tmp[i].hash == tmp[i-1].hash)
+			tmp[i].dup = tmp[i-1].dup + 1;
+	}
+	for (int i = 0; i < n; i++)
+		uids[tmp[i].idx] = tmp[i];
+}
+
+/*
+ * Print the event $e of day $dp as an iCalendar all-day VEVENT.
+ * The UID is derived from the date, the event text and the user, so it
+ * persists across the exports regardless of the other events; the same
+ * events of a day get a counter appended.
+ */
+static void
+event_print_ics(FILE *fp, const struct cal_day *dp, const struct event *e,
+		const struct ics_uid *uid, const struct ics_stamp *stamp)
+{
+	struct ics_writer w = { fp, 0 };
+	const struct cal_desc *desc = e->description;
+	const struct cal_line *line;
+
+	fputs("BEGIN:VEVENT\r\n", fp);
+	fprintf(fp, "UID:%04d%02d%02d-%016" PRIx64, dp->year, dp->month,
+		dp->day, uid->hash);
+	if (uid->dup > 0)
+		fprintf(fp, "-%d", uid->dup);
+	fprintf(fp, "@%s\r\n", stamp->host);
+	fprintf(fp, "DTSTAMP:%s\r\n", stamp->dtstamp);
+	fprintf(fp, "DTSTART;VALUE=DATE:%04d%02d%02d\r\n",
+		dp->year, dp->month, dp->day);
+
+	ics_puts(&w, "SUMMARY:");
+	ics_put_text(&w, desc->firstline->str);
+	if (e->extra) {
+		ics_put_text(&w, " (");
+		ics_put_text(&w, e->extra);
+		ics_put_text(&w, ")");
+	}
+	ics_end_line(&w);
+
+	if (desc->firstline != desc->lastline) {
+		ics_puts(&w, "DESCRIPTION:");
+		for (line = desc->firstline; line; line = line->next) {
+			ics_put_text(&w, line->str);
+			if (line != desc->lastline)
+				ics_put_text(&w, "\n");
+		}
+		ics_end_line(&w);
+	}
+
+	if (e->format->date_user[0] != '\0') {
+		ics_puts(&w, "X-CALENDAR-DATE:");
+		ics_put_text(&w, e->format->date_user);
+		ics_end_line(&w);
+	}
+	if (e->variable)
+		fputs("X-CALENDAR-VARIABLE:TRUE\r\n", fp);
+
+	fputs("END:VEVENT\r\n", fp);
+}
+
+/*
+ * Print all the events of the generated range to $fp.
+ */
 void
 event_print_all(FILE *fp)
+{
+	event_print_range(fp, Options.day_begin, Options.day_end);
+}
+
+/*
+ * Print the events of the days in [$rd_begin, $rd_end] to $fp in the
+ * format of Options.output, streaming from the event lists of the days.
+ * The output is flushed only once at the end unless Options.unbuffered
+ * is set.
+ */
+void
+event_print_range(FILE *fp, int rd_begin, int rd_end)
 {
 	struct event *e;
 	struct cal_day *dp = NULL;
-	struct cal_desc *desc;
-	struct cal_line *line;
-
-	while ((dp = loop_dates(dp)) != NULL) {
-		for (e = dp->events; e != NULL; e = e->next) {
-			fprintf(fp, "%s%c\t", e->date, e->variable ? '*' : ' ');
-			if (e->date_user[0] != '\0')
-				fprintf(fp, "[%s] ", e->date_user);
-
-			desc = e->description;
-			for (line = desc->firstline; line; line = line->next) {
-				fprintf(fp, "%s%s%s",
-					(line == desc->firstline) ? "" : "\t\t",
-					line->str,
-					(line == desc->lastline) ? "" : "\n");
-			}
-			if (e->extra)
-				fprintf(fp, " (%s)", e->extra);
+	struct ics_stamp stamp;
+	struct ics_uid *uids = NULL;
+	int nuids = 0;
+
+	if (Options.output == OUTPUT_ICS) {
+		ics_stamp_init(&stamp);
+		fputs("BEGIN:VCALENDAR\r\n"
+		      "VERSION:2.0\r\n"
+		      "PRODID:-//DragonFly//calendar//EN\r\n", fp);
+	}
 
-			fputc('\n', fp);
-			fflush(fp);
+	while ((dp = loop_pages(dp)) != NULL) {
+		if (dp->rd < rd_begin)
+			continue;
+		if (dp->rd > rd_end)
+			break;
+		if (Options.output == OUTPUT_ICS) {
+			if (dp->nevents > nuids) {
+				nuids = dp->nevents;
+				uids = xrealloc(uids, 2 * (size_t)nuids *
+						sizeof(*uids));
+			}
+			ics_uids_set(dp, &stamp, uids, uids + nuids);
+		}
+		for (int i = 0; i < dp->nevents; i++) {
+			e = &dp->events[i];
+			switch (Options.output) {
+			case OUTPUT_JSON:
+				event_print_json(fp, dp, e);
+				break;
+			case OUTPUT_ICS:
+				event_print_ics(fp, dp, e, &uids[i], &stamp);
+				break;
+			default:
+				event_print_text(fp, e);
+			}
+			if (Options.unbuffered)
+				fflush(fp);
 		}
 	}
+
+	if (Options.output == OUTPUT_ICS)
+		fputs("END:VCALENDAR\r\n", fp);
+	free(uids);
+
+	fflush(fp);
 }
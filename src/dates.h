@@ -38,6 +38,7 @@
 
 struct event;
 struct cal_desc;
+struct day_format;
 
 struct cal_day {
 	int	rd;
@@ -46,7 +47,10 @@ struct cal_day {
 	int	day;
 	int	dow[3];  /* [day-of-week, index-in-month, reverse-index] */
 	bool	last_dom;  /* true if the last day of month */
-	struct event *events;
+	struct event *events;  /* events in the order added */
+	int	nevents;
+	int	maxevents;  /* allocated size of $events */
+	struct day_format *formats;  /* formatted dates of the events */
 };
 
 void	generate_dates(void);
@@ -55,8 +59,10 @@ struct cal_day *loop_dates(struct cal_day *dp);
 
 struct cal_day *find_rd(int rd, int offset);
 
-struct event *event_add(struct cal_day *dp, bool day_first, bool variable,
-			struct cal_desc *desc, char *extra);
+void	event_add(struct cal_day *dp, bool day_first, bool variable,
+		  struct cal_desc *desc, char *extra);
+void	event_locale_changed(void);
 void	event_print_all(FILE *fp);
+void	event_print_range(FILE *fp, int rd_begin, int rd_end);
 
 #endif
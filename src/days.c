@@ -38,6 +38,7 @@
 #include <err.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 #include "calendar.h"
 #include "basics.h"
@@ -74,7 +75,7 @@ static int	find_days_fullmoon(int, struct cal_day **, char **);
 	{ SD_NONE, NULL, 0, NULL, 0, NULL }
 #define SPECIALDAY_INIT(id, name, func) \
 	{ (id), name, sizeof(name)-1, NULL, 0, func }
-struct specialday specialdays[] = {
+struct specialday default_specialdays[] = {
 	SPECIALDAY_INIT(SD_EASTER, "Easter", &find_days_easter),
 	SPECIALDAY_INIT(SD_PASKHA, "Paskha", &find_days_paskha),
 	SPECIALDAY_INIT(SD_ADVENT, "Advent", &find_days_advent),
@@ -91,6 +92,36 @@ struct specialday specialdays[] = {
 };
 
 
+/*
+ * Duplicate the special days without the national names, for a new
+ * context.
+ */
+struct specialday *
+specialdays_dup(void)
+{
+	struct specialday *sdays;
+	size_t n;
+
+	n = sizeof(default_specialdays) / sizeof(default_specialdays[0]);
+	sdays = xcalloc(n, sizeof(*sdays));
+	for (size_t i = 0; i < n; i++) {
+		sdays[i] = default_specialdays[i];
+		sdays[i].n_name = NULL;
+		sdays[i].n_len = 0;
+	}
+
+	return sdays;
+}
+
+void
+specialdays_free(struct specialday *sdays)
+{
+	for (size_t i = 0; sdays[i].name != NULL; i++)
+		free(sdays[i].n_name);
+	free(sdays);
+}
+
+
 static int
 find_days_easter(int offset, struct cal_day **dayp, char **edp)
 {
@@ -362,7 +393,7 @@ find_days_ymd(int year, int month, int day,
 				warnx("%s: too many repeats", __func__);
 				return count;
 			}
-			dayp[count++] = dp;
+			dayp[count++] = find_rd(dp->rd, 0);
 		}
 	}
 
@@ -386,7 +417,7 @@ find_days_dom(int dom, struct cal_day **dayp, char **edp __unused)
 				warnx("%s: too many repeats", __func__);
 				return count;
 			}
-			dayp[count++] = dp;
+			dayp[count++] = find_rd(dp->rd, 0);
 		}
 	}
 
@@ -408,7 +439,7 @@ find_days_month(int month, struct cal_day **dayp, char **edp __unused)
 				warnx("%s: too many repeats", __func__);
 				return count;
 			}
-			dayp[count++] = dp;
+			dayp[count++] = find_rd(dp->rd, 0);
 		}
 	}
 
@@ -440,7 +471,7 @@ find_days_mdow(int month, int dow, int index,
 				warnx("%s: too many repeats", __func__);
 				return count;
 			}
-			dayp[count++] = dp;
+			dayp[count++] = find_rd(dp->rd, 0);
 		}
 	}
 
@@ -67,7 +67,11 @@ struct specialday {
 	int	(*find_days)(int offset, struct cal_day **dayp, char **edp);
 };
 
-extern struct specialday specialdays[];
+/* special days of the default context; see 'struct cal_context' */
+extern struct specialday default_specialdays[];
+
+struct specialday *specialdays_dup(void);
+void	specialdays_free(struct specialday *sdays);
 
 int	find_days_ymd(int year, int month, int day,
 		      struct cal_day **dayp, char **edp);
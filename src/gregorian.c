@@ -45,6 +45,7 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "basics.h"
 #include "gregorian.h"
@@ -56,25 +57,50 @@
  */
 static const int epoch = 1;
 
+/*
+ * The conversions below follow the Euclidean affine functions of:
+ * Cassio Neri and Lorenz Schneider, "Euclidean affine functions and their
+ * application to calendar algorithms", Softw Pract Exper. 2023;53:937-970.
+ *
+ * They count the days and years of a computational calendar starting on
+ * March 1, so that the leap day is the last day of a year, and use only
+ * unsigned arithmetic with constant divisors (compiled to multiplications
+ * and shifts).  To keep the counts non-negative, whole 400-year cycles
+ * are added, which supports the years within about ±1,400,000.
+ */
+
+/*
+ * 400-year cycles shifted to make the computational counts non-negative,
+ * which supports the fixed dates within ±536,000,000 (checked within
+ * ±500,000,000 by test.c); the unsigned counts silently wrap beyond.
+ */
+#define SHIFT_CYCLES	3670
+#define SHIFT_YEARS	((uint32_t)(400 * SHIFT_CYCLES))
+#define SHIFT_DAYS	((uint32_t)(146097 * SHIFT_CYCLES))
+
+/* fixed date of March 1, year 0 */
+#define RD_MARCH_0	(-305)
+
 /*
  * Return true if $year is a leap year on the Gregorian calendar,
  * otherwise return false.
  * Ref: Sec.(2.2), Eq.(2.16)
+ *
+ * A year divisible by 100 is divisible by 400 iff it's divisible by 16.
  */
 bool
 gregorian_leap_year(int year)
 {
-	int r4 = mod(year, 4);
-	int r400 = mod(year, 400);
-	return (r4 == 0 && (r400 != 100 && r400 != 200 && r400 != 300));
+	return (year % 100 != 0) ? (year % 4 == 0) : (year % 16 == 0);
 }
 
 /*
- * Calculate the fixed date (RD) equivalent to the Gregorian date $date.
+ * Calculate the fixed date (RD) equivalent to the Gregorian date $date
+ * with the textbook formula, which also accepts months out of [1, 12].
  * Ref: Sec.(2.2), Eq.(2.17)
  */
-int
-fixed_from_gregorian(const struct date *date)
+static int
+fixed_from_gregorian_generic(const struct date *date)
 {
 	int rd = ((epoch - 1) + 365 * (date->year - 1) +
 		  div_floor(date->year - 1, 4) -
@@ -90,6 +116,27 @@ fixed_from_gregorian(const struct date *date)
 		return rd + date->day - 2;
 }
 
+/*
+ * Calculate the fixed date (RD) equivalent to the Gregorian date $date.
+ */
+int
+fixed_from_gregorian(const struct date *date)
+{
+	uint32_t y, m, c, j, ndays;
+
+	if (date->month < 1 || date->month > 12)
+		return fixed_from_gregorian_generic(date);
+
+	/* January and February belong to the previous computational year */
+	j = (date->month <= 2);
+	y = (uint32_t)date->year + SHIFT_YEARS - j;
+	m = (uint32_t)date->month + 12 * j;
+	c = y / 100;
+
+	ndays = 1461 * y / 4 - c + c / 4 + (979 * m - 2919) / 32;
+	return (int)ndays - (int)SHIFT_DAYS + RD_MARCH_0 + date->day - 1;
+}
+
 /*
  * Calculate the fixed date of January 1 in year $year.
  * Ref: Sec.(2.2), Eq.(2.18)
@@ -101,28 +148,38 @@ gregorian_new_year(int year)
 	return fixed_from_gregorian(&date);
 }
 
+/*
+ * Split the fixed date $rd into the computational year (starting on
+ * March 1) and the day of that year ($*nday: [0, 365]).
+ */
+static inline uint32_t
+gregorian_split(int rd, uint32_t *nday)
+{
+	uint32_t n, n1, c, nc, n2;
+	uint64_t p2;
+
+	n = (uint32_t)(rd - RD_MARCH_0) + SHIFT_DAYS;
+	n1 = 4 * n + 3;
+	c = n1 / 146097;
+	nc = n1 % 146097 / 4;
+
+	n2 = 4 * nc + 3;
+	p2 = (uint64_t)2939745 * n2;
+	*nday = (uint32_t)p2 / 2939745 / 4;
+	return 100 * c + (uint32_t)(p2 >> 32);
+}
+
 /*
  * Calculate the Gregorian year corresponding to the fixed date $rd.
- * Ref: Sec.(2.2), Eq.(2.21)
  */
 int
 gregorian_year_from_fixed(int rd)
 {
-	int d0 = rd - epoch;
-	int d1 = mod(d0, 146097);
-	int d2 = mod(d1, 36524);
-	int d3 = mod(d2, 1461);
-
-	int n400 = div_floor(d0, 146097);
-	int n100 = div_floor(d1, 36524);
-	int n4 = div_floor(d2, 1461);
-	int n1 = div_floor(d3, 365);
-
-	int year = 400 * n400 + 100 * n100 + 4 * n4 + n1;
-	if (n100 == 4 || n1 == 4)
-		return year;
-	else
-		return year + 1;
+	uint32_t nday, y;
+
+	y = gregorian_split(rd, &nday);
+	/* January and February (day 306 on) belong to the next year */
+	return (int)y + (nday >= 306) - (int)SHIFT_YEARS;
 }
 
 /*
@@ -139,27 +196,19 @@ gregorian_date_difference(const struct date *date1,
 /*
  * Calculate the Gregorian date (year, month, day) corresponding to the
  * fixed date $rd.
- * Ref: Sec.(2.2), Eq.(2.23)
  */
 void
 gregorian_from_fixed(int rd, struct date *date)
 {
-	int correction, pdays;
-
-	date->year = gregorian_year_from_fixed(rd);
-
-	struct date d = { date->year, 3, 1 };
-	if (rd < fixed_from_gregorian(&d))
-		correction = 0;
-	else if (gregorian_leap_year(date->year))
-		correction = 1;
-	else
-		correction = 2;
+	uint32_t nday, y, n3, m, d, j;
 
-	d.month = 1;
-	pdays = rd - fixed_from_gregorian(&d);
-	date->month = div_floor(12 * (pdays + correction) + 373, 367);
+	y = gregorian_split(rd, &nday);
+	n3 = 2141 * nday + 197913;
+	m = n3 / 65536;
+	d = n3 % 65536 / 2141;
 
-	d.month = date->month;
-	date->day = rd - fixed_from_gregorian(&d) + 1;
+	j = (nday >= 306);
+	date->year = (int)(y + j) - (int)SHIFT_YEARS;
+	date->month = (int)(j ? m - 12 : m);
+	date->day = (int)d + 1;
 }
@@ -42,11 +42,16 @@
 #include <assert.h>
 #include <ctype.h>
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>  /* required on Linux for setgroups() */
 #include <langinfo.h>
 #include <locale.h>
 #include <paths.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -82,14 +87,82 @@ struct cal_file {
 	char	*nextline;	/* to store the rewinded line */
 	size_t	 nextline_cap;	/* capacity of the 'nextline' buffer */
 	bool	 rewinded;	/* if 'nextline' has the rewinded line */
+	struct cal_desc **descriptions;  /* list to add the descriptions */
 };
 
-static struct cal_desc *descriptions = NULL;
-static struct node *definitions = NULL;
+enum { OP_EVENT, OP_DEFINE, OP_VARIABLE };
 
-static FILE	*cal_fopen(const char *file);
-static bool	 cal_parse(FILE *in);
-static bool	 process_token(char *line, bool *skip);
+/* recorded effect of an entry of a calendar file */
+struct cal_op {
+	int	 type;
+	int	 rd;		/* date of the event (OP_EVENT) */
+	bool	 variable;	/* variable event (OP_EVENT) */
+	struct cal_desc *description;  /* event description (OP_EVENT) */
+	char	*name;		/* event extra data, definition or variable */
+	char	*value;		/* variable value (OP_VARIABLE) */
+};
+
+/* definition tested by '#ifndef' */
+struct cal_test {
+	char	*name;
+	bool	 defined;
+};
+
+/*
+ * Segment of a shared calendar file, i.e., its entries from the beginning
+ * or an '#include' to the next '#include' or the end, with the effects
+ * recorded to be replayed instead of parsing it again in the same state
+ * (see cal_state()) and with the same results of its '#ifndef's.  The
+ * segments are split at the '#include's, since the included file may
+ * leave a different state for the rest.
+ */
+struct cal_segment {
+	struct cal_segment *next;  /* in the hash bucket */
+	char	*path;
+	int	 index;		/* index of the segment in the file */
+	char	*state;		/* state at the beginning of the segment */
+	struct cal_test *tests;	/* definitions the segment depends on */
+	int	 ntests;
+	int	 maxtests;
+	struct cal_op *ops;
+	int	 nops;
+	int	 maxops;
+	struct cal_desc *descriptions;  /* descriptions of the events */
+	char	*include;	/* file included at the end, or NULL */
+	long	 next_offset;	/* file offset of the next segment */
+};
+
+#define CACHE_BUCKETS	256
+
+/* parsed calendar files shared by the contexts */
+struct cal_cache {
+	pthread_mutex_t	 lock;
+	bool		(*shared)(const char *path);
+	struct cal_segment *buckets[CACHE_BUCKETS];
+};
+
+/* state of a calendar file being parsed or replayed */
+struct cal_frame {
+	locale_t locale;	/* locale set by 'LANG' */
+	bool	 d_first;	/* whether day before month in the locale */
+	bool	 locale_changed;
+	bool	 calendar_changed;
+	struct cal_segment *segment;  /* segment being recorded, or NULL */
+	struct node *definitions;  /* definitions before the segment */
+};
+
+static FILE	*cal_fopen(const char *file, char *path, size_t size);
+static bool	 cal_include(const char *file);
+static void	 cal_define(const char *name);
+static bool	 cal_parse(FILE *in, const char *path);
+static bool	 cal_parse_entries(FILE *in, struct cal_frame *frame);
+static char	*cal_state(void);
+static bool	 cal_abspath(const char *path, char *buf, size_t size);
+static bool	 locale_day_first(void);
+static bool	 process_token(char *line, bool *skip,
+			       struct cal_frame *frame);
+static void	 process_variable(const char *variable, const char *value,
+				  struct cal_frame *frame);
 static void	 send_mail(FILE *fp);
 static char	*skip_comment(char *line, int *comment);
 static void	 write_mailheader(FILE *fp);
@@ -101,6 +174,22 @@ static void	 cal_rewindline(struct cal_file *cfile);
 static bool	 is_date_entry(char *line, char **content);
 static bool	 is_variable_entry(char *line, char **value);
 
+static unsigned int segment_bucket(const char *path, int index);
+static struct cal_op *segment_addop(struct cal_segment *seg, int type);
+static void	 segment_addtest(struct cal_frame *frame, const char *name,
+				 bool defined);
+static bool	 segment_match(const struct cal_segment *seg,
+			       const char *path, int index, const char *state,
+			       const struct cal_segment *other);
+static struct cal_segment *segment_lookup(struct cal_cache *cache,
+					  const char *path, int index,
+					  const char *state);
+static struct cal_segment *segment_publish(struct cal_cache *cache,
+					   struct cal_segment *seg);
+static void	 segment_replay(const struct cal_segment *seg,
+				struct cal_frame *frame);
+static void	 segment_free(struct cal_segment *seg, bool handover);
+
 static struct cal_desc *cal_desc_new(struct cal_desc **head);
 static void	 cal_desc_freeall(struct cal_desc *head);
 static void	 cal_desc_addline(struct cal_desc *desc, const char *line);
@@ -146,28 +235,69 @@ skip_comment(char *line, int *comment)
 }
 
 
+/*
+ * Open the calendar file $file in the calendar directories, and store
+ * the path of the opened file in $path.
+ */
 static FILE *
-cal_fopen(const char *file)
+cal_fopen(const char *file, char *path, size_t size)
 {
 	FILE *fp = NULL;
-	char fpath[MAXPATHLEN];
 
 	for (size_t i = 0; calendarDirs[i] != NULL; i++) {
-		snprintf(fpath, sizeof(fpath), "%s/%s",
-			 calendarDirs[i], file);
-		if ((fp = fopen(fpath, "r")) != NULL)
+		snprintf(path, size, "%s/%s", calendarDirs[i], file);
+		if (cal_ctx->open_file != NULL)
+			fp = cal_ctx->open_file(path, cal_ctx->open_arg);
+		else
+			fp = fopen(path, "r");
+		if (fp != NULL) {
+			struct cal_context *ctx = cal_ctx;
+
+			if (ctx->nincluded == ctx->maxincluded) {
+				ctx->maxincluded = (ctx->maxincluded > 0) ?
+					2 * ctx->maxincluded : 16;
+				ctx->included_files = xrealloc(
+					ctx->included_files,
+					(size_t)ctx->maxincluded *
+					sizeof(*ctx->included_files));
+			}
+			ctx->included_files[ctx->nincluded++] = xstrdup(path);
 			return (fp);
+		}
 	}
 
 	warnx("Cannot open calendar file: '%s'", file);
 	return (NULL);
 }
 
+static bool
+cal_include(const char *file)
+{
+	char path[MAXPATHLEN];
+	FILE *fp;
+	bool ret;
+
+	if ((fp = cal_fopen(file, path, sizeof(path))) == NULL)
+		return false;
+	if (!(ret = cal_parse(fp, path)))
+		warnx("Failed to parse calendar files");
+
+	fclose(fp);
+	return ret;
+}
+
+static void
+cal_define(const char *name)
+{
+	struct node *new = list_newnode(xstrdup(name), NULL);
+	cal_ctx->definitions = list_addfront(cal_ctx->definitions, new);
+}
+
 /*
  * NOTE: input 'line' should have trailing comment and whitespace trimmed.
  */
 static bool
-process_token(char *line, bool *skip)
+process_token(char *line, bool *skip, struct cal_frame *frame)
 {
 	char *walk;
 
@@ -216,17 +346,13 @@ process_token(char *line, bool *skip)
 		walk++;
 		walk[strlen(walk) - 1] = '\0';
 
-		FILE *fpin = cal_fopen(walk);
-		if (fpin == NULL)
-			return false;
-		if (!cal_parse(fpin)) {
-			warnx("Failed to parse calendar files");
-			fclose(fpin);
-			return false;
+		/* the recorded segment ends before the included file */
+		if (frame->segment != NULL) {
+			frame->segment->include = xstrdup(walk);
+			return true;
 		}
 
-		fclose(fpin);
-		return true;
+		return cal_include(walk);
 
 	} else if (string_startswith(line, "#define ") ||
 	           string_startswith(line, "#define\t")) {
@@ -236,8 +362,10 @@ process_token(char *line, bool *skip)
 			return false;
 		}
 
-		struct node *new = list_newnode(xstrdup(walk), NULL);
-		definitions = list_addfront(definitions, new);
+		cal_define(walk);
+		if (frame->segment != NULL)
+			segment_addop(frame->segment, OP_DEFINE)->name =
+				xstrdup(walk);
 
 		return true;
 
@@ -249,8 +377,10 @@ process_token(char *line, bool *skip)
 			return false;
 		}
 
-		if (list_lookup(definitions, walk, strcmp, NULL))
+		if (list_lookup(cal_ctx->definitions, walk, strcmp, NULL))
 			*skip = true;
+		if (frame->segment != NULL)
+			segment_addtest(frame, walk, *skip);
 
 		return true;
 	}
@@ -259,6 +389,73 @@ process_token(char *line, bool *skip)
 	return false;
 }
 
+static void
+process_variable(const char *variable, const char *value,
+		 struct cal_frame *frame)
+{
+	struct specialday *sday;
+	struct cal_op *op;
+	bool var_handled = false;
+	locale_t loc;
+
+	if (strcasecmp(variable, "LANG") == 0) {
+		/*
+		 * Use a locale of this thread only, so that the other
+		 * contexts are not disturbed.
+		 */
+		loc = newlocale(LC_ALL_MASK, value, (locale_t)0);
+		if (loc == (locale_t)0) {
+			warnx("Failed to set LC_ALL='%s'", value);
+		} else {
+			uselocale(loc);
+			if (frame->locale != (locale_t)0)
+				freelocale(frame->locale);
+			frame->locale = loc;
+			free(cal_ctx->lang);
+			cal_ctx->lang = xstrdup(value);
+		}
+		frame->d_first = locale_day_first();
+		set_nnames();
+		event_locale_changed();
+		frame->locale_changed = true;
+		DPRINTF("%s: set LC_ALL='%s' (day_first=%s)\n",
+			__func__, value, frame->d_first ? "true" : "false");
+		var_handled = true;
+	}
+
+	if (strcasecmp(variable, "CALENDAR") == 0) {
+		if (!set_calendar(value))
+			warnx("Failed to set CALENDAR='%s'", value);
+		frame->calendar_changed = true;
+		DPRINTF("%s: set CALENDAR='%s'\n", __func__, value);
+		var_handled = true;
+	}
+
+	if (strcasecmp(variable, "SEQUENCE") == 0) {
+		set_nsequences(value);
+		var_handled = true;
+	}
+
+	for (size_t i = 0; cal_ctx->specialdays[i].name; i++) {
+		sday = &cal_ctx->specialdays[i];
+		if (strcasecmp(variable, sday->name) == 0) {
+			free(sday->n_name);
+			sday->n_name = xstrdup(value);
+			sday->n_len = strlen(sday->n_name);
+			var_handled = true;
+			break;
+		}
+	}
+
+	if (!var_handled) {
+		warnx("Unknown variable: |%s|=|%s|", variable, value);
+	} else if (frame->segment != NULL) {
+		op = segment_addop(frame->segment, OP_VARIABLE);
+		op->name = xstrdup(variable);
+		op->value = xstrdup(value);
+	}
+}
+
 static bool
 locale_day_first(void)
 {
@@ -268,91 +465,149 @@ locale_day_first(void)
 	return (strpbrk(d_fmt, "ed") < strchr(d_fmt, 'm'));
 }
 
+/*
+ * Parse the calendar file $in (of $path, or NULL if unknown).  The
+ * segments of a file shared by the cache of the context are replayed if
+ * they have been parsed in the same state, or parsed and recorded.
+ */
+static bool
+cal_parse(FILE *in, const char *path)
+{
+	struct cal_frame frame = { 0 };
+	struct cal_cache *cache = cal_ctx->cache;
+	struct cal_segment *seg;
+	char key[MAXPATHLEN], *state;
+	long offset = 0;
+	bool ret = true;
+
+	assert(in != NULL);
+	frame.locale = (locale_t)0;
+	frame.d_first = locale_day_first();
+
+	if (cache == NULL || path == NULL || !cache->shared(path) ||
+	    !cal_abspath(path, key, sizeof(key))) {
+		ret = cal_parse_entries(in, &frame);
+		goto out;
+	}
+	path = key;  /* the relative paths differ by the calendar home */
+
+	for (int index = 0; ; index++) {
+		state = cal_state();
+		if ((seg = segment_lookup(cache, path, index, state)) != NULL) {
+			DPRINTF2("%s: replay segment %d of %s\n",
+				 __func__, index, path);
+			free(state);
+			segment_replay(seg, &frame);
+		} else {
+			seg = xcalloc(1, sizeof(*seg));
+			seg->path = xstrdup(path);
+			seg->index = index;
+			seg->state = state;
+			if (offset != 0 && fseek(in, offset, SEEK_SET) == -1) {
+				warn("fseek(%s)", path);
+				ret = false;
+			} else {
+				frame.segment = seg;
+				frame.definitions = cal_ctx->definitions;
+				ret = cal_parse_entries(in, &frame);
+				frame.segment = NULL;
+			}
+			if (!ret) {
+				segment_free(seg, true);
+				break;
+			}
+			seg = segment_publish(cache, seg);
+		}
+
+		if (seg->include == NULL)
+			break;
+		if (!cal_include(seg->include)) {
+			ret = false;
+			break;
+		}
+		offset = seg->next_offset;
+	}
+
+out:
+	/*
+	 * Reset to the default locale, so that one calendar file that changed
+	 * the locale (by defining the "LANG" variable) does not interfere the
+	 * following calendar files without the "LANG" definition.
+	 */
+	if (frame.locale_changed) {
+		uselocale(LC_GLOBAL_LOCALE);
+		if (frame.locale != (locale_t)0)
+			freelocale(frame.locale);
+		free(cal_ctx->lang);
+		cal_ctx->lang = NULL;
+		set_nnames();
+		event_locale_changed();
+		DPRINTF("%s: reset LC_ALL\n", __func__);
+	}
+
+	if (frame.calendar_changed) {
+		set_calendar(NULL);
+		DPRINTF("%s: reset CALENDAR\n", __func__);
+	}
+
+	return ret;
+}
+
+/*
+ * Parse the entries of the calendar file $in from the current position
+ * until its end, or until an '#include' if recording a segment.
+ */
 static bool
-cal_parse(FILE *in)
+cal_parse_entries(FILE *in, struct cal_frame *frame)
 {
 	struct cal_file cfile = { 0 };
 	struct cal_entry entry = { 0 };
+	struct cal_segment *seg = frame->segment;
 	struct cal_desc *desc;
 	struct cal_line *line;
+	struct cal_op *op;
 	struct cal_day *cdays[CAL_MAX_REPEAT] = { NULL };
-	struct specialday *sday;
 	char *extradata[CAL_MAX_REPEAT] = { NULL };
-	bool d_first, skip, var_handled;
-	bool locale_changed, calendar_changed;
+	bool skip = false;
+	bool ret = true;
 	int flags, count;
 
-	assert(in != NULL);
 	cfile.fp = in;
-	d_first = locale_day_first();
-	skip = false;
-	locale_changed = false;
-	calendar_changed = false;
+	cfile.descriptions = (seg != NULL) ? &seg->descriptions :
+					     &cal_ctx->descriptions;
 
 	while (cal_readentry(&cfile, &entry, skip)) {
+		if (cal_ctx->deadline != 0 && time(NULL) > cal_ctx->deadline) {
+			warnx("Timed out parsing calendar files");
+			free(entry.token);
+			free(entry.variable);
+			free(entry.value);
+			free(entry.date);
+			ret = false;
+			break;
+		}
+
 		if (entry.type == T_TOKEN) {
 			DPRINTF2("%s: T_TOKEN: |%s|\n",
 				 __func__, entry.token);
-			if (!process_token(entry.token, &skip)) {
+			if (!process_token(entry.token, &skip, frame)) {
 				free(entry.token);
-				return false;
+				ret = false;
+				break;
 			}
 
 			free(entry.token);
+			if (seg != NULL && seg->include != NULL) {
+				seg->next_offset = ftell(in);
+				break;
+			}
 			continue;
 		}
 
 		if (entry.type == T_VARIABLE) {
 			DPRINTF2("%s: T_VARIABLE: |%s|=|%s|\n",
 				 __func__, entry.variable, entry.value);
-			var_handled = false;
-
-			if (strcasecmp(entry.variable, "LANG") == 0) {
-				if (setlocale(LC_ALL, entry.value) == NULL) {
-					warnx("Failed to set LC_ALL='%s'",
-					      entry.value);
-				}
-				d_first = locale_day_first();
-				set_nnames();
-				locale_changed = true;
-				DPRINTF("%s: set LC_ALL='%s' (day_first=%s)\n",
-					__func__, entry.value,
-					d_first ? "true" : "false");
-				var_handled = true;
-			}
-
-			if (strcasecmp(entry.variable, "CALENDAR") == 0) {
-				if (!set_calendar(entry.value)) {
-					warnx("Failed to set CALENDAR='%s'",
-					      entry.value);
-				}
-				calendar_changed = true;
-				DPRINTF("%s: set CALENDAR='%s'\n",
-					__func__, entry.value);
-				var_handled = true;
-			}
-
-			if (strcasecmp(entry.variable, "SEQUENCE") == 0) {
-				set_nsequences(entry.value);
-				var_handled = true;
-			}
-
-			for (size_t i = 0; specialdays[i].name; i++) {
-				sday = &specialdays[i];
-				if (strcasecmp(entry.variable, sday->name) == 0) {
-					free(sday->n_name);
-					sday->n_name = xstrdup(entry.value);
-					sday->n_len = strlen(sday->n_name);
-					var_handled = true;
-					break;
-				}
-			}
-
-			if (!var_handled) {
-				warnx("Unknown variable: |%s|=|%s|",
-				      entry.variable, entry.value);
-			}
-
+			process_variable(entry.variable, entry.value, frame);
 			free(entry.variable);
 			free(entry.value);
 			continue;
@@ -370,16 +625,33 @@ cal_parse(FILE *in)
 			if (count < 0) {
 				warnx("Cannot parse date |%s| with content |%s|",
 				      entry.date, desc->firstline->str);
-				continue;
 			} else if (count == 0) {
 				DPRINTF2("Ignore out-of-range date |%s| "
 					 "with content |%s|\n",
 					 entry.date, desc->firstline->str);
+			}
+			if (count <= 0) {
+				/* not kept by the cache without any event */
+				if (seg != NULL) {
+					seg->descriptions = desc->next;
+					desc->next = NULL;
+					cal_desc_freeall(desc);
+				}
+				free(entry.date);
 				continue;
 			}
 
 			for (int i = 0; i < count; i++) {
-				event_add(cdays[i], d_first,
+				if (seg != NULL) {
+					op = segment_addop(seg, OP_EVENT);
+					op->rd = cdays[i]->rd;
+					op->variable = ((flags & F_VARIABLE) != 0);
+					op->description = desc;
+					if (extradata[i] != NULL &&
+					    extradata[i][0] != '\0')
+						op->name = xstrdup(extradata[i]);
+				}
+				event_add(cdays[i], frame->d_first,
 				          ((flags & F_VARIABLE) != 0),
 				          desc, extradata[i]);
 				cdays[i] = NULL;
@@ -393,28 +665,271 @@ cal_parse(FILE *in)
 		errx(1, "Invalid calendar entry type: %d", entry.type);
 	}
 
-	/*
-	 * Reset to the default locale, so that one calendar file that changed
-	 * the locale (by defining the "LANG" variable) does not interfere the
-	 * following calendar files without the "LANG" definition.
-	 */
-	if (locale_changed) {
-		setlocale(LC_ALL, "");
-		set_nnames();
-		DPRINTF("%s: reset LC_ALL\n", __func__);
+	free(cfile.line);
+	free(cfile.nextline);
+
+	return ret;
+}
+
+
+/*
+ * Get the state that parsing a calendar file depends on: the date range
+ * and location, the locale and calendar, and the names set by the
+ * variables.  The definitions are checked by the segments instead, as
+ * only those tested by '#ifndef' matter.
+ */
+static char *
+cal_state(void)
+{
+	const struct location *loc = Options.location;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	if ((fp = open_memstream(&buf, &len)) == NULL)
+		err(1, "open_memstream");
+
+	fprintf(fp, "%d %d %d %a %a %a %a\n%s\n%s\n",
+		Options.today, Options.day_begin, Options.day_end,
+		loc->latitude, loc->longitude, loc->elevation, loc->zone,
+		(cal_ctx->lang != NULL) ? cal_ctx->lang : "",
+		Calendar->name);
+	for (size_t i = 0; cal_ctx->specialdays[i].name; i++) {
+		fprintf(fp, "%s=%s\n", cal_ctx->specialdays[i].name,
+			(cal_ctx->specialdays[i].n_name != NULL) ?
+			cal_ctx->specialdays[i].n_name : "");
+	}
+	for (int i = 0; i < NSEQUENCES; i++) {
+		fprintf(fp, "%s=%s\n", cal_ctx->sequence_names[i].name,
+			(cal_ctx->sequence_names[i].n_name != NULL) ?
+			cal_ctx->sequence_names[i].n_name : "");
 	}
 
-	if (calendar_changed) {
-		set_calendar(NULL);
-		DPRINTF("%s: reset CALENDAR\n", __func__);
+	if (fclose(fp) != 0)
+		err(1, "open_memstream");
+	return buf;
+}
+
+/*
+ * Get the absolute path of the file $path, i.e., against the current
+ * directory (the calendar home) if relative.
+ */
+static bool
+cal_abspath(const char *path, char *buf, size_t size)
+{
+	char cwd[MAXPATHLEN];
+	int n;
+
+	if (path[0] == '/') {
+		n = snprintf(buf, size, "%s", path);
+	} else {
+		if (getcwd(cwd, sizeof(cwd)) == NULL)
+			return false;
+		if (strncmp(path, "./", 2) == 0)
+			path += 2;
+		n = snprintf(buf, size, "%s/%s", cwd, path);
 	}
 
-	free(cfile.line);
-	free(cfile.nextline);
+	return (n > 0 && (size_t)n < size);
+}
+
+static unsigned int
+segment_bucket(const char *path, int index)
+{
+	uint32_t hash = 2166136261U;  /* FNV-1a */
+
+	for (; *path != '\0'; path++) {
+		hash ^= (unsigned char)*path;
+		hash *= 16777619U;
+	}
+	return (hash + (uint32_t)index) % CACHE_BUCKETS;
+}
+
+static struct cal_op *
+segment_addop(struct cal_segment *seg, int type)
+{
+	struct cal_op *op;
+
+	if (seg->nops == seg->maxops) {
+		seg->maxops = (seg->maxops > 0) ? 2 * seg->maxops : 16;
+		seg->ops = xrealloc(seg->ops,
+				    (size_t)seg->maxops * sizeof(*seg->ops));
+	}
+	op = &seg->ops[seg->nops++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
 
+	return op;
+}
+
+/*
+ * Record the test of definition $name by '#ifndef', unless the segment
+ * has defined it itself, i.e., the result does not depend on the state.
+ */
+static void
+segment_addtest(struct cal_frame *frame, const char *name, bool defined)
+{
+	struct cal_segment *seg = frame->segment;
+	struct cal_test *test;
+
+	if (defined &&
+	    !list_lookup(frame->definitions, name, strcmp, NULL))
+		return;
+
+	for (int i = 0; i < seg->ntests; i++) {
+		if (strcmp(seg->tests[i].name, name) == 0)
+			return;
+	}
+	if (seg->ntests == seg->maxtests) {
+		seg->maxtests = (seg->maxtests > 0) ? 2 * seg->maxtests : 4;
+		seg->tests = xrealloc(seg->tests, (size_t)seg->maxtests *
+				      sizeof(*seg->tests));
+	}
+	test = &seg->tests[seg->ntests++];
+	test->name = xstrdup(name);
+	test->defined = defined;
+}
+
+/*
+ * Whether the segment $seg is of the file $path and state $state, with
+ * the same results of the '#ifndef's as the recorded segment $other, or
+ * (if $other is NULL) with the current definitions.
+ */
+static bool
+segment_match(const struct cal_segment *seg, const char *path, int index,
+	      const char *state, const struct cal_segment *other)
+{
+	bool defined;
+
+	if (seg->index != index || strcmp(seg->path, path) != 0 ||
+	    strcmp(seg->state, state) != 0)
+		return false;
+	if (other != NULL && other->ntests != seg->ntests)
+		return false;
+
+	for (int i = 0; i < seg->ntests; i++) {
+		if (other != NULL) {
+			if (strcmp(seg->tests[i].name,
+				   other->tests[i].name) != 0)
+				return false;
+			defined = other->tests[i].defined;
+		} else {
+			defined = list_lookup(cal_ctx->definitions,
+					      seg->tests[i].name, strcmp,
+					      NULL);
+		}
+		if (defined != seg->tests[i].defined)
+			return false;
+	}
 	return true;
 }
 
+static struct cal_segment *
+segment_lookup(struct cal_cache *cache, const char *path, int index,
+	       const char *state)
+{
+	struct cal_segment *seg;
+
+	pthread_mutex_lock(&cache->lock);
+	for (seg = cache->buckets[segment_bucket(path, index)];
+	     seg != NULL; seg = seg->next) {
+		if (segment_match(seg, path, index, state, NULL))
+			break;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	return seg;
+}
+
+/*
+ * Add the recorded segment $seg to the cache.  If another context has
+ * added the same segment meanwhile, free $seg but its descriptions, which
+ * are used by the events and so handed over to the context.  Return the
+ * segment in the cache.
+ */
+static struct cal_segment *
+segment_publish(struct cal_cache *cache, struct cal_segment *seg)
+{
+	struct cal_segment *sp;
+	unsigned int b;
+
+	b = segment_bucket(seg->path, seg->index);
+	pthread_mutex_lock(&cache->lock);
+	for (sp = cache->buckets[b]; sp != NULL; sp = sp->next) {
+		if (segment_match(sp, seg->path, seg->index, seg->state, seg))
+			break;
+	}
+	if (sp == NULL) {
+		seg->next = cache->buckets[b];
+		cache->buckets[b] = seg;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (sp == NULL)
+		return seg;
+
+	segment_free(seg, true);
+	return sp;
+}
+
+static void
+segment_replay(const struct cal_segment *seg, struct cal_frame *frame)
+{
+	const struct cal_op *op;
+	struct cal_day *dp;
+
+	for (int i = 0; i < seg->nops; i++) {
+		op = &seg->ops[i];
+		switch (op->type) {
+		case OP_EVENT:
+			if ((dp = find_rd(op->rd, 0)) == NULL)
+				break;
+			event_add(dp, frame->d_first, op->variable,
+				  op->description,
+				  (op->name != NULL) ? xstrdup(op->name) : NULL);
+			break;
+		case OP_DEFINE:
+			cal_define(op->name);
+			break;
+		case OP_VARIABLE:
+			process_variable(op->name, op->value, frame);
+			break;
+		}
+	}
+}
+
+/*
+ * Free the segment $seg.  If $handover is true, its descriptions may be
+ * used by the events of the context and are handed over to it instead.
+ */
+static void
+segment_free(struct cal_segment *seg, bool handover)
+{
+	struct cal_desc *desc;
+
+	if (handover && (desc = seg->descriptions) != NULL) {
+		while (desc->next != NULL)
+			desc = desc->next;
+		desc->next = cal_ctx->descriptions;
+		cal_ctx->descriptions = seg->descriptions;
+	} else {
+		cal_desc_freeall(seg->descriptions);
+	}
+
+	for (int i = 0; i < seg->ntests; i++)
+		free(seg->tests[i].name);
+	free(seg->tests);
+	for (int i = 0; i < seg->nops; i++) {
+		free(seg->ops[i].name);
+		free(seg->ops[i].value);
+	}
+	free(seg->ops);
+	free(seg->include);
+	free(seg->state);
+	free(seg->path);
+	free(seg);
+}
+
 static bool
 cal_readentry(struct cal_file *cfile, struct cal_entry *entry, bool skip)
 {
@@ -467,7 +982,7 @@ cal_readentry(struct cal_file *cfile, struct cal_entry *entry, bool skip)
 
 			entry->type = T_DATE;
 			entry->date = xstrdup(p);
-			entry->description = cal_desc_new(&descriptions);
+			entry->description = cal_desc_new(cfile->descriptions);
 			cal_desc_addline(entry->description, content);
 
 			/* Continuous description of the event */
@@ -611,37 +1126,199 @@ cal_desc_addline(struct cal_desc *desc, const char *line)
 }
 
 
+/*
+ * Parse the calendar file $fpin (of $path, or NULL if unknown) and add the
+ * events to the dates, which can then be printed (in whole or in part)
+ * until cal_unload().
+ */
+bool
+cal_load(FILE *fpin, const char *path)
+{
+	for (int i = 0; i < cal_ctx->nincluded; i++)
+		free(cal_ctx->included_files[i]);
+	cal_ctx->nincluded = 0;
+
+	if (!cal_parse(fpin, path)) {
+		warnx("Failed to parse calendar files");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Free the definitions and event descriptions of the parsed files.
+ */
+void
+cal_unload(void)
+{
+	list_freeall(cal_ctx->definitions, free, NULL);
+	cal_ctx->definitions = NULL;
+	cal_desc_freeall(cal_ctx->descriptions);
+	cal_ctx->descriptions = NULL;
+}
+
+/*
+ * Parse the calendar file $fpin and print the events to $fpout.
+ */
+int
+cal_print(FILE *fpin, FILE *fpout)
+{
+	int ret = 0;
+
+	if (cal_load(fpin, NULL))
+		event_print_all(fpout);
+	else
+		ret = 1;
+	cal_unload();
+
+	return ret;
+}
+
+/*
+ * Evaluate the calendar file $fpin in the context $ctx, i.e., generate
+ * the dates of the range in $ctx->options, then parse the file and print
+ * the events to $fpout.  Different contexts can be evaluated concurrently
+ * in different threads.
+ */
+int
+cal_eval(struct cal_context *ctx, FILE *fpin, FILE *fpout)
+{
+	struct cal_context *prev;
+	int ret;
+
+	prev = cal_context_set(ctx);
+	generate_dates();
+	ret = cal_print(fpin, fpout);
+	free_dates();
+	cal_context_set(prev);
+
+	return ret;
+}
+
 int
 cal(FILE *fpin)
 {
-	if (!cal_parse(fpin)) {
-		warnx("Failed to parse calendar files");
+	FILE *fpout;
+	int ret;
+
+	if (!Options.allmode)
+		return cal_print(fpin, stdout);
+
+	/*
+	 * Use a temporary output file, so we can skip sending mail
+	 * if there is no output.
+	 */
+	if ((fpout = tmpfile()) == NULL) {
+		warn("tmpfile");
 		return 1;
 	}
+	/* not inherited by the sendmail of other threads ('-a -j') */
+	fcntl(fileno(fpout), F_SETFD, FD_CLOEXEC);
+	setvbuf(fpout, NULL, _IOFBF, OUTPUT_BUFSIZE);
+	ret = cal_print(fpin, fpout);
+	if (ret == 0)
+		send_mail(fpout);
+	else
+		fclose(fpout);
 
-	if (Options.allmode) {
-		FILE *fpout;
+	return ret;
+}
 
-		/*
-		 * Use a temporary output file, so we can skip sending mail
-		 * if there is no output.
-		 */
-		if ((fpout = tmpfile()) == NULL) {
-			warn("tmpfile");
-			return 1;
+/*
+ * Get the paths of the files included by the last cal_print().
+ * Return the number of files.
+ */
+int
+cal_included_files(const char *const **files)
+{
+	*files = (const char *const *)cal_ctx->included_files;
+	return cal_ctx->nincluded;
+}
+
+/*
+ * Create a cache of the parsed calendar files, which can be shared by the
+ * contexts (see cal_context.cache) evaluating the same date range and
+ * location, also in different threads.  Only the files for which
+ * $shared returns true are cached, i.e., those with the same contents for
+ * all the contexts.
+ */
+struct cal_cache *
+cal_cache_new(bool (*shared)(const char *path))
+{
+	struct cal_cache *cache;
+
+	cache = xcalloc(1, sizeof(*cache));
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->shared = shared;
+
+	return cache;
+}
+
+/*
+ * Drop the cached segments of the file $path (NULL for all files), which
+ * must not be used by the events of any context.
+ */
+void
+cal_cache_drop(struct cal_cache *cache, const char *path)
+{
+	struct cal_segment **spp, *seg;
+
+	pthread_mutex_lock(&cache->lock);
+	for (int i = 0; i < CACHE_BUCKETS; i++) {
+		spp = &cache->buckets[i];
+		while ((seg = *spp) != NULL) {
+			if (path == NULL || strcmp(seg->path, path) == 0) {
+				*spp = seg->next;
+				segment_free(seg, false);
+			} else {
+				spp = &seg->next;
+			}
 		}
-		event_print_all(fpout);
-		send_mail(fpout);
-	} else {
-		event_print_all(stdout);
 	}
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Free the cache, after all the contexts using it have unloaded their
+ * files.
+ */
+void
+cal_cache_free(struct cal_cache *cache)
+{
+	struct cal_segment *seg;
 
-	list_freeall(definitions, free, NULL);
-	definitions = NULL;
-	cal_desc_freeall(descriptions);
-	descriptions = NULL;
+	if (cache == NULL)
+		return;
 
-	return 0;
+	for (int i = 0; i < CACHE_BUCKETS; i++) {
+		while ((seg = cache->buckets[i]) != NULL) {
+			cache->buckets[i] = seg->next;
+			segment_free(seg, false);
+		}
+	}
+	pthread_mutex_destroy(&cache->lock);
+	free(cache);
+}
+
+/*
+ * Reset the names set by the variables of the calendar files, so that
+ * the next cal_print() starts afresh.
+ */
+void
+cal_reset(void)
+{
+	for (size_t i = 0; cal_ctx->specialdays[i].name; i++) {
+		free(cal_ctx->specialdays[i].n_name);
+		cal_ctx->specialdays[i].n_name = NULL;
+		cal_ctx->specialdays[i].n_len = 0;
+	}
+	for (int i = 0; i < NSEQUENCES; i++) {
+		free(cal_ctx->sequence_names[i].n_name);
+		cal_ctx->sequence_names[i].n_name = NULL;
+		cal_ctx->sequence_names[i].n_len = 0;
+	}
+	set_nnames();
 }
 
 
@@ -649,6 +1326,7 @@ static void
 send_mail(FILE *fp)
 {
 	int ch, pdes[2];
+	pid_t pid;
 	FILE *fpipe;
 
 	assert(Options.allmode == true);
@@ -657,12 +1335,13 @@ send_mail(FILE *fp)
 		DPRINTF("%s: no events; skip sending mail\n", __func__);
 		return;
 	}
-	if (pipe(pdes) < 0) {
+	/* not inherited by the sendmail of other threads ('-a -j') */
+	if (pipe2(pdes, O_CLOEXEC) < 0) {
 		warnx("pipe");
 		return;
 	}
 
-	switch (fork()) {
+	switch ((pid = fork())) {
 	case -1:
 		close(pdes[0]);
 		close(pdes[1]);
@@ -670,10 +1349,19 @@ send_mail(FILE *fp)
 	case 0:
 		/* child -- set stdin to pipe output */
 		if (pdes[0] != STDIN_FILENO) {
-			dup2(pdes[0], STDIN_FILENO);
+			dup2(pdes[0], STDIN_FILENO);  /* clears FD_CLOEXEC */
 			close(pdes[0]);
+		} else {
+			fcntl(STDIN_FILENO, F_SETFD, 0);
 		}
 		close(pdes[1]);
+		/* mail as the user if evaluated on behalf of it */
+		if (cal_ctx->mail_user != NULL &&
+		    (setgroups((size_t)cal_ctx->mail_ngroups,
+			       cal_ctx->mail_groups) == -1 ||
+		     setgid(cal_ctx->mail_gid) == -1 ||
+		     setuid(cal_ctx->mail_uid) == -1))
+			_exit(1);
 		execl(_PATH_SENDMAIL, "sendmail", "-i", "-t", "-F",
 		      "\"Reminder Service\"", (char *)NULL);
 		warn(_PATH_SENDMAIL);
@@ -696,15 +1384,16 @@ send_mail(FILE *fp)
 
 done:
 	fclose(fp);
-	while (wait(NULL) >= 0)
+	/* only wait for our child; there may be other threads mailing */
+	while (pid > 0 && waitpid(pid, NULL, 0) == -1 && errno == EINTR)
 		;
 }
 
 static void
 write_mailheader(FILE *fp)
 {
-	uid_t uid = getuid();
-	struct passwd *pw = getpwuid(uid);
+	const char *user = cal_ctx->mail_user;
+	struct passwd *pw;
 	struct date date;
 	char dayname[32] = { 0 };
 	int dow;
@@ -712,8 +1401,13 @@ write_mailheader(FILE *fp)
 	gregorian_from_fixed(Options.today, &date);
 	dow = dayofweek_from_fixed(Options.today);
 	sprintf(dayname, "%s, %d %s %d",
-		dow_names[dow].f_name, date.day,
-		month_names[date.month-1].f_name, date.year);
+		cal_ctx->dow_names[dow].f_name, date.day,
+		cal_ctx->month_names[date.month-1].f_name, date.year);
+
+	if (user == NULL) {
+		pw = getpwuid(getuid());
+		user = pw->pw_name;
+	}
 
 	fprintf(fp,
 		"From: %s (Reminder Service)\n"
@@ -721,6 +1415,6 @@ write_mailheader(FILE *fp)
 		"Subject: %s's Calendar\n"
 		"Precedence: bulk\n"
 		"Auto-Submitted: auto-generated\n\n",
-		pw->pw_name, pw->pw_name, dayname);
+		user, user, dayname);
 	fflush(fp);
 }
@@ -36,6 +36,9 @@
 #ifndef IO_H_
 #define IO_H_
 
+#include <stdbool.h>
+#include <stdio.h>
+
 struct cal_line {
 	struct cal_line *next;
 	char		*str;
@@ -47,6 +50,18 @@ struct cal_desc {
 	struct cal_line *lastline;
 };
 
+struct cal_cache;
+
 int	cal(FILE *fp);
+bool	cal_load(FILE *fpin, const char *path);
+void	cal_unload(void);
+int	cal_print(FILE *fpin, FILE *fpout);
+int	cal_eval(struct cal_context *ctx, FILE *fpin, FILE *fpout);
+int	cal_included_files(const char *const **files);
+void	cal_reset(void);
+
+struct cal_cache *cal_cache_new(bool (*shared)(const char *path));
+void	cal_cache_drop(struct cal_cache *cache, const char *path);
+void	cal_cache_free(struct cal_cache *cache);
 
 #endif
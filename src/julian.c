@@ -40,6 +40,7 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "calendar.h"
@@ -55,6 +56,25 @@
  */
 static const int epoch = -1;  /* Gregorian: 0, December, 30 */
 
+/*
+ * The conversions below count the days and (astronomical) years of a
+ * computational calendar starting on March 1, like those in gregorian.c.
+ * Whole 4-year cycles are added to keep the counts non-negative, which
+ * supports the years within about ±1,400,000.
+ */
+
+/*
+ * 4-year cycles shifted to make the computational counts non-negative,
+ * which supports the fixed dates within ±536,000,000 (checked within
+ * ±500,000,000 by test.c); the unsigned counts silently wrap beyond.
+ */
+#define SHIFT_CYCLES	367000
+#define SHIFT_YEARS	((uint32_t)(4 * SHIFT_CYCLES))
+#define SHIFT_DAYS	((uint32_t)(1461 * SHIFT_CYCLES))
+
+/* fixed date of March 1, 1 B.C.E. (astronomical year 0) */
+#define RD_MARCH_0	(-307)
+
 /*
  * Return true if $year is a leap year on the Julian calendar,
  * otherwise return false.
@@ -68,11 +88,12 @@ julian_leap_year(int year)
 }
 
 /*
- * Calculate the fixed date (RD) equivalent to the Julian date $date.
+ * Calculate the fixed date (RD) equivalent to the Julian date $date
+ * with the textbook formula, which also accepts months out of [1, 12].
  * Ref: Sec.(3.1), Eq.(3.3)
  */
-int
-fixed_from_julian(const struct date *date)
+static int
+fixed_from_julian_generic(const struct date *date)
 {
 	int y = (date->year >= 0) ? date->year : (date->year + 1);
 	int rd = ((epoch - 1) + 365 * (y - 1) +
@@ -87,34 +108,53 @@ fixed_from_julian(const struct date *date)
 		return rd + date->day - 2;
 }
 
+/*
+ * Calculate the fixed date (RD) equivalent to the Julian date $date.
+ */
+int
+fixed_from_julian(const struct date *date)
+{
+	uint32_t y, m, j, ndays;
+	int year;
+
+	if (date->month < 1 || date->month > 12)
+		return fixed_from_julian_generic(date);
+
+	/* no year 0 */
+	year = (date->year >= 0) ? date->year : (date->year + 1);
+	/* January and February belong to the previous computational year */
+	j = (date->month <= 2);
+	y = (uint32_t)year + SHIFT_YEARS - j;
+	m = (uint32_t)date->month + 12 * j;
+
+	ndays = 1461 * y / 4 + (979 * m - 2919) / 32;
+	return (int)ndays - (int)SHIFT_DAYS + RD_MARCH_0 + date->day - 1;
+}
+
 /*
  * Calculate the Julian date (year, month, day) corresponding to the
  * fixed date $rd.
- * Ref: Sec.(3.1), Eq.(3.4)
  */
 void
 julian_from_fixed(int rd, struct date *date)
 {
-	int correction, pdays;
+	uint32_t n, n1, y, nday, n3, m, d, j;
+	int year;
 
-	date->year = div_floor(4 * (rd - epoch) + 1464, 1461);
-	if (date->year <= 0)
-		date->year--;
-
-	struct date d = { date->year, 3, 1 };
-	if (rd < fixed_from_julian(&d))
-		correction = 0;
-	else if (julian_leap_year(date->year))
-		correction = 1;
-	else
-		correction = 2;
+	n = (uint32_t)(rd - RD_MARCH_0) + SHIFT_DAYS;
+	n1 = 4 * n + 3;
+	y = n1 / 1461;
+	nday = n1 % 1461 / 4;
 
-	d.month = 1;
-	pdays = rd - fixed_from_julian(&d);
-	date->month = div_floor(12 * (pdays + correction) + 373, 367);
+	n3 = 2141 * nday + 197913;
+	m = n3 / 65536;
+	d = n3 % 65536 / 2141;
 
-	d.month = date->month;
-	date->day = rd - fixed_from_julian(&d) + 1;
+	j = (nday >= 306);
+	year = (int)(y + j) - (int)SHIFT_YEARS;
+	date->year = (year > 0) ? year : (year - 1);  /* no year 0 */
+	date->month = (int)(j ? m - 12 : m);
+	date->day = (int)d + 1;
 }
 
 /**************************************************************************/
@@ -39,6 +39,7 @@
  * 2018, Cambridge University Press
  */
 
+#include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -59,6 +60,65 @@
 const double mean_synodic_month = 29.530588861;
 
 
+/* maximum multiple of an angle in the periodic terms */
+#define MULTIPLE_MAX	4
+
+/*
+ * Sines and cosines of the multiples [-MULTIPLE_MAX, MULTIPLE_MAX] of an
+ * angle, indexed by (multiple + MULTIPLE_MAX).
+ */
+struct multiples {
+	double	sin[2 * MULTIPLE_MAX + 1];
+	double	cos[2 * MULTIPLE_MAX + 1];
+};
+
+/*
+ * Build the multiples of angle $deg (in degrees) with the angle-addition
+ * recurrences, which need only one pair of sine and cosine calls.
+ */
+static void
+multiples_init(double deg, struct multiples *m)
+{
+	const int o = MULTIPLE_MAX;
+	double s1 = sin_deg(deg);
+	double c1 = cos_deg(deg);
+
+	m->sin[o] = 0.0;
+	m->cos[o] = 1.0;
+	for (int k = 1; k <= MULTIPLE_MAX; k++) {
+		m->sin[o+k] = m->sin[o+k-1] * c1 + m->cos[o+k-1] * s1;
+		m->cos[o+k] = m->cos[o+k-1] * c1 - m->sin[o+k-1] * s1;
+		m->sin[o-k] = -m->sin[o+k];
+		m->cos[o-k] = m->cos[o+k];
+	}
+}
+
+/*
+ * Calculate the sine and cosine of the angle (sum of $k[i] * angle[i])
+ * from the multiples $m[] of the $n angles.
+ */
+static void
+multiples_sincos(const struct multiples *m, const int *k, size_t n,
+		 double *sinv, double *cosv)
+{
+	double s = 0.0, c = 1.0, s2, c2, tmp;
+
+	for (size_t i = 0; i < n; i++) {
+		if (k[i] == 0)
+			continue;
+		/* a table edit must not exceed the built multiples */
+		assert(k[i] >= -MULTIPLE_MAX && k[i] <= MULTIPLE_MAX);
+		s2 = m[i].sin[MULTIPLE_MAX + k[i]];
+		c2 = m[i].cos[MULTIPLE_MAX + k[i]];
+		tmp = s * c2 + c * s2;
+		c = c * c2 - s * s2;
+		s = tmp;
+	}
+
+	*sinv = s;
+	*cosv = c;
+}
+
 /*
  * Argument data 1 used by 'nth_new_moon()'.
  * Ref: Sec.(14.6), Table(14.3)
@@ -126,18 +186,17 @@ static const struct nth_new_moon_arg2 {
  * This function is centered upon January, 2000.
  * Ref: Sec.(14.6), Eq.(14.45)
  */
-double
-nth_new_moon(int n)
+static double
+nth_new_moon_calc(int n)
 {
 	int n0 = 24724;  /* Months from RD 0 until j2000 */
 	int k = n - n0;  /* Months since j2000 */
 	double nm = 1236.85;  /* Months per century */
 	double c = k / nm;  /* Julian centuries */
-	double j2000 = 0.5 + gregorian_new_year(2000);
 
 	double coef_ap[] = { 5.09766, mean_synodic_month * nm,
 			     0.00015437, -0.000000150, 0.00000000073 };
-	double approx = j2000 + poly(c, coef_ap, nitems(coef_ap));
+	double approx = J2000 + poly(c, coef_ap, nitems(coef_ap));
 
 	double extra = 0.000325 * sin_deg(299.77 + 132.8475848 * c -
 					  0.009173 * c*c);
@@ -156,14 +215,19 @@ nth_new_moon(int n)
 	double omega = poly(c, coef_om, nitems(coef_om));
 	double E = 1.0 - 0.002516 * c - 0.0000074 * c*c;
 
-	double sum_c = 0.0;
+	struct multiples m[3];
+	multiples_init(solar_anomaly, &m[0]);
+	multiples_init(lunar_anomaly, &m[1]);
+	multiples_init(moon_argument, &m[2]);
+	double Epow[3] = { 1.0, E, E*E };
+
+	double sum_c = 0.0, sinv, cosv;
 	const struct nth_new_moon_arg1 *arg1;
 	for (size_t i = 0; i < nitems(nth_new_moon_data1); i++) {
 		arg1 = &nth_new_moon_data1[i];
-		sum_c += arg1->v * pow(E, arg1->w) * sin_deg(
-				arg1->x * solar_anomaly +
-				arg1->y * lunar_anomaly +
-				arg1->z * moon_argument);
+		int mk[3] = { arg1->x, arg1->y, arg1->z };
+		multiples_sincos(m, mk, nitems(mk), &sinv, &cosv);
+		sum_c += arg1->v * Epow[arg1->w] * sinv;
 	}
 	double correction = -0.00017 * sin_deg(omega) + sum_c;
 
@@ -178,6 +242,33 @@ nth_new_moon(int n)
 	return universal_from_dynamical(dt);
 }
 
+/* number of cached lunations; must be a power of 2 */
+#define NEW_MOON_CACHE_SIZE	64
+
+/*
+ * Get the moment of the $n-th new moon, with the recently used lunations
+ * cached per thread, since the new moon searches evaluate the adjacent
+ * lunations again and again.
+ */
+double
+nth_new_moon(int n)
+{
+	static __thread struct {
+		int	n;
+		bool	valid;
+		double	moment;
+	} cache[NEW_MOON_CACHE_SIZE];
+	int i = mod(n, NEW_MOON_CACHE_SIZE);
+
+	if (!cache[i].valid || cache[i].n != n) {
+		cache[i].n = n;
+		cache[i].moment = nth_new_moon_calc(n);
+		cache[i].valid = true;
+	}
+
+	return cache[i].moment;
+}
+
 /*
  * Mean longitude of moon at moment given in Julian centuries $c.
  * Ref: Sec.(14.6), Eq.(14.49)
@@ -242,6 +333,42 @@ moon_node(double c)
 	return mod_f(poly(c, coef, nitems(coef)), 360);
 }
 
+/*
+ * Fundamental arguments shared by the lunar longitude, latitude and
+ * distance series at a moment.
+ */
+struct lunar_args {
+	double	c;		/* Julian centuries */
+	double	L_prime;	/* mean longitude */
+	double	D;		/* elongation */
+	double	M;		/* solar anomaly */
+	double	M_prime;	/* lunar anomaly */
+	double	F;		/* argument of latitude */
+	double	E[3];		/* powers of the eccentricity factor E */
+	struct multiples m[4];	/* multiples of D, M, M_prime and F */
+};
+
+static void
+lunar_args_init(double t, struct lunar_args *args)
+{
+	double c = julian_centuries(t);
+	double E = 1.0 - 0.002516 * c - 0.0000074 * c*c;
+
+	args->c = c;
+	args->L_prime = lunar_longitude_mean(c);
+	args->D = lunar_elongation(c);
+	args->M = solar_anomaly(c);
+	args->M_prime = lunar_anomaly(c);
+	args->F = moon_node(c);
+	args->E[0] = 1.0;
+	args->E[1] = E;
+	args->E[2] = E * E;
+	multiples_init(args->D, &args->m[0]);
+	multiples_init(args->M, &args->m[1]);
+	multiples_init(args->M_prime, &args->m[2]);
+	multiples_init(args->F, &args->m[3]);
+}
+
 /*
  * Argument data used by 'lunar_longitude()'.
  * Ref: Sec.(14.6), Table(14.5)
@@ -318,28 +445,21 @@ static const struct lunar_longitude_arg {
  * Calculate the geocentric longitude of moon (in degrees) at moment $t.
  * Ref: Sec.(14.6), Eq.(14.48)
  */
-double
-lunar_longitude(double t)
+static double
+lunar_longitude_series(double t, const struct lunar_args *args)
 {
-	double c = julian_centuries(t);
+	double c = args->c;
+	double L_prime = args->L_prime;
+	double F = args->F;
 	double nu = nutation(t);
 
-	double L_prime = lunar_longitude_mean(c);
-	double D = lunar_elongation(c);
-	double M = solar_anomaly(c);
-	double M_prime = lunar_anomaly(c);
-	double F = moon_node(c);
-	double E = 1.0 - 0.002516 * c - 0.0000074 * c*c;
-
-	double sum = 0.0;
+	double sum = 0.0, sinv, cosv;
 	const struct lunar_longitude_arg *arg;
 	for (size_t i = 0; i < nitems(lunar_longitude_data); i++) {
 		arg = &lunar_longitude_data[i];
-		sum += arg->v * pow(E, abs(arg->x)) * sin_deg(
-				arg->w * D +
-				arg->x * M +
-				arg->y * M_prime +
-				arg->z * F);
+		int k[4] = { arg->w, arg->x, arg->y, arg->z };
+		multiples_sincos(args->m, k, nitems(k), &sinv, &cosv);
+		sum += arg->v * args->E[abs(arg->x)] * sinv;
 	}
 	double correction = sum / 1e6;
 
@@ -351,6 +471,31 @@ lunar_longitude(double t)
 		      flat_earth + nu), 360);
 }
 
+double
+lunar_longitude_exact(double t)
+{
+	struct lunar_args args;
+
+	lunar_args_init(t, &args);
+	return lunar_longitude_series(t, &args);
+}
+
+/*
+ * Calculate the geocentric longitude of moon (in degrees) at moment $t
+ * with the piecewise Chebyshev approximation of 'lunar_longitude_exact()'.
+ * The approximation error is below 1e-7 degree.
+ */
+double
+lunar_longitude(double t)
+{
+	static __thread struct angular_approx approx = {
+		.func = lunar_longitude_exact,
+		.nsegments = 45,
+		.nnodes = 13,
+	};
+	return angular_approx_eval(&approx, t);
+}
+
 /*
  * Argument data used by 'lunar_latitude()'.
  * Ref: Sec.(14.6), Table(14.6)
@@ -429,27 +574,21 @@ static const struct lunar_latitude_arg {
  * Lunar latitude ranges from about -6 to 6 degress.
  * Ref: Sec.(14.6), Eq.(14.63)
  */
-double
-lunar_latitude(double t)
+static double
+lunar_latitude_series(const struct lunar_args *args)
 {
-	double c = julian_centuries(t);
+	double c = args->c;
+	double L_prime = args->L_prime;
+	double M_prime = args->M_prime;
+	double F = args->F;
 
-	double L_prime = lunar_longitude_mean(c);
-	double D = lunar_elongation(c);
-	double M = solar_anomaly(c);
-	double M_prime = lunar_anomaly(c);
-	double F = moon_node(c);
-	double E = 1.0 - 0.002516 * c - 0.0000074 * c*c;
-
-	double sum = 0.0;
+	double sum = 0.0, sinv, cosv;
 	const struct lunar_latitude_arg *arg;
 	for (size_t i = 0; i < nitems(lunar_latitude_data); i++) {
 		arg = &lunar_latitude_data[i];
-		sum += arg->v * pow(E, abs(arg->x)) * sin_deg(
-				arg->w * D +
-				arg->x * M +
-				arg->y * M_prime +
-				arg->z * F);
+		int k[4] = { arg->w, arg->x, arg->y, arg->z };
+		multiples_sincos(args->m, k, nitems(k), &sinv, &cosv);
+		sum += arg->v * args->E[abs(arg->x)] * sinv;
 	}
 	double beta = sum / 1e6;
 
@@ -463,6 +602,15 @@ lunar_latitude(double t)
 	return (beta + venus + flat_earth + extra);
 }
 
+double
+lunar_latitude(double t)
+{
+	struct lunar_args args;
+
+	lunar_args_init(t, &args);
+	return lunar_latitude_series(&args);
+}
+
 /*
  * Argument data used by 'lunar_distance()'.
  * Ref: Sec.(14.6), Table(14.7)
@@ -540,31 +688,46 @@ static const struct lunar_distance_arg {
  * Calculate the distance to moon (in meters) at moment $t.
  * Ref: Sec.(14.6), Eq.(14.65)
  */
-double
-lunar_distance(double t)
+static double
+lunar_distance_series(const struct lunar_args *args)
 {
-	double c = julian_centuries(t);
-
-	double D = lunar_elongation(c);
-	double M = solar_anomaly(c);
-	double M_prime = lunar_anomaly(c);
-	double F = moon_node(c);
-	double E = 1.0 - 0.002516 * c - 0.0000074 * c*c;
-
-	double correction = 0.0;
+	double correction = 0.0, sinv, cosv;
 	const struct lunar_distance_arg *arg;
 	for (size_t i = 0; i < nitems(lunar_distance_data); i++) {
 		arg = &lunar_distance_data[i];
-		correction += arg->v * pow(E, abs(arg->x)) * cos_deg(
-				arg->w * D +
-				arg->x * M +
-				arg->y * M_prime +
-				arg->z * F);
+		int k[4] = { arg->w, arg->x, arg->y, arg->z };
+		multiples_sincos(args->m, k, nitems(k), &sinv, &cosv);
+		correction += arg->v * args->E[abs(arg->x)] * cosv;
 	}
 
 	return 385000560.0 + correction;
 }
 
+double
+lunar_distance(double t)
+{
+	struct lunar_args args;
+
+	lunar_args_init(t, &args);
+	return lunar_distance_series(&args);
+}
+
+/*
+ * Calculate the geocentric longitude, latitude and distance of moon at
+ * moment $t, with the fundamental arguments shared by the three series.
+ * Ref: Sec.(14.6), Eq.(14.48), (14.63), (14.65)
+ */
+void
+lunar_position(double t, struct lunar_position *pos)
+{
+	struct lunar_args args;
+
+	lunar_args_init(t, &args);
+	pos->longitude = lunar_longitude_series(t, &args);
+	pos->latitude = lunar_latitude_series(&args);
+	pos->distance = lunar_distance_series(&args);
+}
+
 /*
  * Calculate the altitude of moon (in degrees) above the horizon at
  * location ($latitude, $longitude) and moment $t, ignoring parallax
@@ -573,11 +736,12 @@ lunar_distance(double t)
  * of the Earth.
  * Ref: Sec.(14.6), Eq.(14.64)
  */
-double
-lunar_altitude(double t, double latitude, double longitude)
+static double
+lunar_altitude_from(double t, const struct lunar_position *pos,
+		    double latitude, double longitude)
 {
-	double lambda = lunar_longitude(t);
-	double beta = lunar_latitude(t);
+	double lambda = pos->longitude;
+	double beta = pos->latitude;
 	double alpha = right_ascension(t, beta, lambda);
 	double delta = declination(t, beta, lambda);
 	double theta = sidereal_from_moment(t);
@@ -588,15 +752,22 @@ lunar_altitude(double t, double latitude, double longitude)
 	return mod3_f(arcsin_deg(v), -180, 180);
 }
 
+double
+lunar_altitude(double t, double latitude, double longitude)
+{
+	struct lunar_position pos;
+
+	lunar_position(t, &pos);
+	return lunar_altitude_from(t, &pos, latitude, longitude);
+}
+
 /*
- * Parallax of moon at moment $t and location ($latitude, $longitude).
+ * Parallax of moon with geocentric altitude $geo and distance $distance.
  * Ref: Sec.(14.6), Eq.(14.66)
  */
 static double
-lunar_parallax(double t, double latitude, double longitude)
+lunar_parallax(double geo, double distance)
 {
-	double geo = lunar_altitude(t, latitude, longitude);
-	double distance = lunar_distance(t);
 	/* Equatorial horizontal parallax of the moon */
 	double sin_pi = 6378140.0 / distance;
 	return arcsin_deg(sin_pi * cos_deg(geo));
@@ -610,8 +781,11 @@ lunar_parallax(double t, double latitude, double longitude)
 static double
 lunar_altitude_topocentric(double t, double latitude, double longitude)
 {
-	return (lunar_altitude(t, latitude, longitude) -
-		lunar_parallax(t, latitude, longitude));
+	struct lunar_position pos;
+
+	lunar_position(t, &pos);
+	double geo = lunar_altitude_from(t, &pos, latitude, longitude);
+	return geo - lunar_parallax(geo, pos.distance);
 }
 
 /*
@@ -710,100 +884,166 @@ new_moon_atafter(double t)
 	return t1;
 }
 
+/* interval (in days) between the altitude samples */
+#define CROSSING_STEP		(2.0 / 24.0)
+/* accuracy (in days) of the moonrise/moonset moments */
+#define CROSSING_EPS		(1.0 / 3600 / 24)
+
+/*
+ * Refine the moment of the horizon crossing of moon between the moments
+ * $a and $b (universal time), where the observed altitudes $fa and $fb
+ * have different signs, with the Illinois regula falsi.
+ */
+static double
+lunar_crossing_refine(const struct location *loc,
+		      double a, double fa, double b, double fb)
+{
+	double x = a, x_prev, fx;
+	int side = 0;
+
+	for (int i = 0; i < 50; i++) {
+		x_prev = x;
+		x = (a * fb - b * fa) / (fb - fa);
+		fx = lunar_altitude_observed(x, loc);
+		if ((fx > 0) == (fb > 0)) {
+			b = x;
+			fb = fx;
+			if (side == 1)
+				fa /= 2.0;
+			side = 1;
+		} else {
+			a = x;
+			fa = fx;
+			if (side == -1)
+				fb /= 2.0;
+			side = -1;
+		}
+
+		if (fabs(x - x_prev) < CROSSING_EPS || b - a < CROSSING_EPS)
+			break;
+	}
+
+	return x;
+}
+
+/*
+ * Add the crossing between moments $a and $b (universal time) with
+ * observed altitudes $fa and $fb to the $crossings array.
+ */
+static int
+lunar_crossing_add(const struct location *loc,
+		   double a, double fa, double b, double fb,
+		   struct lunar_crossing *crossings, int n, int max)
+{
+	if (n >= max)
+		return n;
+
+	crossings[n].t = lunar_crossing_refine(loc, a, fa, b, fb) + loc->zone;
+	crossings[n].rising = (fb > 0);
+	return n + 1;
+}
+
+/*
+ * Find the moonrises and moonsets in standard time on fixed date $rd at
+ * location $loc, and store them in time order into the $crossings array
+ * of size $max.  Return the number of crossings found, which can be 0
+ * (e.g., the moon is above or below the horizon for the whole day), 1
+ * or 2, and more near the polar regions.
+ *
+ * The observed altitude is sampled every 2 hours over the day.  Every
+ * sign change between adjacent samples brackets a crossing.  A pair of
+ * crossings within the same sample interval is detected by the
+ * extremum of the parabola through the neighboring samples.  All
+ * crossings are then refined to an accuracy of 1 second.
+ */
+int
+lunar_crossings(int rd, const struct location *loc,
+		struct lunar_crossing *crossings, int max)
+{
+	enum { NSAMPLES = 13 };  /* 24 hours / CROSSING_STEP + 1 */
+	double ts[NSAMPLES], alts[NSAMPLES];
+	double t0 = (double)rd - loc->zone;  /* universal time */
+	double ta, tb, fa, fb, t_ext, f_ext, p, q;
+	int n = 0;
+
+	for (int k = 0; k < NSAMPLES; k++) {
+		ts[k] = t0 + k * CROSSING_STEP;
+		alts[k] = lunar_altitude_observed(ts[k], loc);
+	}
+
+	for (int k = 0; k < NSAMPLES - 1; k++) {
+		ta = ts[k];
+		tb = ts[k+1];
+		fa = alts[k];
+		fb = alts[k+1];
+
+		if ((fa > 0) != (fb > 0)) {
+			n = lunar_crossing_add(loc, ta, fa, tb, fb,
+					       crossings, n, max);
+			continue;
+		}
+
+		/*
+		 * Fit the parabola f(x) = p*x^2 + q*x + c through the
+		 * samples at x = -1, 0, 1 around this interval, and
+		 * check whether its extremum lies within the interval
+		 * and on the other side of the horizon.
+		 */
+		int j = (k == 0) ? 1 : k;
+		p = (alts[j+1] + alts[j-1]) / 2.0 - alts[j];
+		q = (alts[j+1] - alts[j-1]) / 2.0;
+		if (p == 0.0)
+			continue;
+		t_ext = ts[j] + (-q / (2.0 * p)) * CROSSING_STEP;
+		if (t_ext <= ta || t_ext >= tb)
+			continue;
+		f_ext = lunar_altitude_observed(t_ext, loc);
+		if ((f_ext > 0) == (fa > 0))
+			continue;
+
+		n = lunar_crossing_add(loc, ta, fa, t_ext, f_ext,
+				       crossings, n, max);
+		n = lunar_crossing_add(loc, t_ext, f_ext, tb, fb,
+				       crossings, n, max);
+	}
+
+	return n;
+}
+
 /*
  * Calculate the moment of moonrise in standard time on fixed date $rd
  * at location $loc.
  * NOTE: Return an NaN if no moonrise.
- * Ref: Sec.(14.7), Eq.(14.83)
  */
 double
 moonrise(int rd, const struct location *loc)
 {
-	double t = (double)rd - loc->zone;  /* universal time */
-	bool waning = lunar_phase(t) > 180.0;
-	/* lunar altitude at midnight */
-	double alt = lunar_altitude_observed(t, loc);
-	double offset = alt / (4.0 * (90.0 - fabs(loc->latitude)));
-
-	/* approximate rising time */
-	double t_approx = t;
-	if (waning) {
-		t_approx -= offset;
-		if (offset > 0)
-			t_approx += 1;
-	} else {
-		t_approx += 0.5 + offset;
-	}
+	struct lunar_crossing crossings[MOON_CROSSINGS_MAX];
+	int n = lunar_crossings(rd, loc, crossings, MOON_CROSSINGS_MAX);
 
-	/* binary search to determine the rising time */
-	const double eps = 30.0 / 3600 / 24;  /* accuracy of 30 seconds */
-	double a = t_approx - 6.0/24.0;
-	double b = t_approx + 6.0/24.0;
-	double t_rise;
-	do {
-		t_rise = (a + b) / 2.0;
-		if (lunar_altitude_observed(t_rise, loc) > 0)
-			b = t_rise;
-		else
-			a = t_rise;
-	} while (fabs(a - b) >= eps);
-
-	if (t_rise < t + 1) {
-		t_rise += loc->zone;  /* standard time */
-		/* may be just before to midnight */
-		return (t_rise > (double)rd) ? t_rise : (double)rd;
-	} else {
-		/* no moonrise on this day */
-		return NAN;
+	for (int i = 0; i < n; i++) {
+		if (crossings[i].rising)
+			return crossings[i].t;
 	}
+	return NAN;
 }
 
 /*
  * Calculate the moment of moonset in standard time on fixed date $rd
  * at location $loc.
  * NOTE: Return an NaN if no moonset.
- * Ref: Sec.(14.7), Eq.(14.84)
  */
 double
 moonset(int rd, const struct location *loc)
 {
-	double t = (double)rd - loc->zone;  /* universal time */
-	bool waxing = lunar_phase(t) < 180.0;
-	/* lunar altitude at midnight */
-	double alt = lunar_altitude_observed(t, loc);
-	double offset = alt / (4.0 * (90.0 - fabs(loc->latitude)));
-
-	/* approximate setting time */
-	double t_approx = t;
-	if (waxing) {
-		t_approx += offset;
-		if (offset <= 0)
-			t_approx += 1;
-	} else {
-		t_approx += 0.5 - offset;
-	}
+	struct lunar_crossing crossings[MOON_CROSSINGS_MAX];
+	int n = lunar_crossings(rd, loc, crossings, MOON_CROSSINGS_MAX);
 
-	/* binary search to determine the setting time */
-	const double eps = 30.0 / 3600 / 24;  /* accuracy of 30 seconds */
-	double a = t_approx - 6.0/24.0;
-	double b = t_approx + 6.0/24.0;
-	double t_set;
-	do {
-		t_set = (a + b) / 2.0;
-		if (lunar_altitude_observed(t_set, loc) < 0)
-			b = t_set;
-		else
-			a = t_set;
-	} while (fabs(a - b) >= eps);
-
-	if (t_set < t + 1) {
-		t_set += loc->zone;  /* standard time */
-		/* may be just before to midnight */
-		return (t_set > (double)rd) ? t_set : (double)rd;
-	} else {
-		/* no moonrise on this day */
-		return NAN;
+	for (int i = 0; i < n; i++) {
+		if (!crossings[i].rising)
+			return crossings[i].t;
 	}
+	return NAN;
 }
 
 /**************************************************************************/
@@ -860,24 +1100,23 @@ show_moon_info(double t, const struct location *loc)
 	 * Moon rise and set
 	 */
 
-	double moments[2] = { moonrise(rd, loc), moonset(rd, loc) };
-	const char *names[2] = { "Moonrise", "Moonset" };
-	if (!isnan(moments[0]) && !isnan(moments[1]) &&
-	    moments[0] > moments[1]) {
-		double t_tmp = moments[0];
-		moments[0] = moments[1];
-		moments[1] = t_tmp;
-		const char *p = names[0];
-		names[0] = names[1];
-		names[1] = p;
-	}
-	for (size_t i = 0; i < nitems(moments); i++) {
-		if (isnan(moments[i]))
-			snprintf(buf, sizeof(buf), "(null)");
+	struct lunar_crossing crossings[MOON_CROSSINGS_MAX];
+	int ncrossings = lunar_crossings(rd, loc, crossings,
+					 MOON_CROSSINGS_MAX);
+	bool has_rise = false, has_set = false;
+	for (int i = 0; i < ncrossings; i++) {
+		if (crossings[i].rising)
+			has_rise = true;
 		else
-			format_time(buf, sizeof(buf), moments[i]);
-		printf("%-8s: %s\n", names[i], buf);
+			has_set = true;
+		format_time(buf, sizeof(buf), crossings[i].t);
+		printf("%-8s: %s\n",
+		       crossings[i].rising ? "Moonrise" : "Moonset", buf);
 	}
+	if (!has_rise)
+		printf("%-8s: (null)\n", "Moonrise");
+	if (!has_set)
+		printf("%-8s: (null)\n", "Moonset");
 
 	/*
 	 * Moon phases in the year
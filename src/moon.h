@@ -37,13 +37,23 @@
 #ifndef MOON_H_
 #define MOON_H_
 
+#include <stdbool.h>
+
 #include "basics.h"
 
 extern const double mean_synodic_month;
 
+struct lunar_position {
+	double	longitude;	/* geocentric longitude (degrees) */
+	double	latitude;	/* geocentric latitude (degrees) */
+	double	distance;	/* meters */
+};
+
 double	lunar_distance(double t);
 double	lunar_latitude(double t);
 double	lunar_longitude(double t);
+double	lunar_longitude_exact(double t);
+void	lunar_position(double t, struct lunar_position *pos);
 
 double	lunar_altitude(double t, double latitude, double longitude);
 double	lunar_altitude_observed(double t, const struct location *loc);
@@ -54,6 +64,16 @@ double	new_moon_atafter(double t);
 double	new_moon_before(double t);
 double	nth_new_moon(int n);
 
+/* maximum number of moonrises and moonsets in a day */
+#define MOON_CROSSINGS_MAX	4
+
+struct lunar_crossing {
+	double	t;	/* moment in standard time */
+	bool	rising;	/* moonrise or moonset */
+};
+
+int	lunar_crossings(int rd, const struct location *loc,
+			struct lunar_crossing *crossings, int max);
 double	moonrise(int rd, const struct location *loc);
 double	moonset(int rd, const struct location *loc);
 
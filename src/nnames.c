@@ -54,7 +54,7 @@
 	  NULL, 0, NULL, 0 }
 
 /* names of every day of week */
-struct nname dow_names[NDOWS+1] = {
+struct nname default_dow_names[NDOWS+1] = {
 	NNAME_INIT2(0, "Sun", "Sunday"),
 	NNAME_INIT2(1, "Mon", "Monday"),
 	NNAME_INIT2(2, "Tue", "Tuesday"),
@@ -66,7 +66,7 @@ struct nname dow_names[NDOWS+1] = {
 };
 
 /* names of every month */
-struct nname month_names[NMONTHS+1] = {
+struct nname default_month_names[NMONTHS+1] = {
 	NNAME_INIT2(1, "Jan", "January"),
 	NNAME_INIT2(2, "Feb", "February"),
 	NNAME_INIT2(3, "Mar", "March"),
@@ -83,7 +83,7 @@ struct nname month_names[NMONTHS+1] = {
 };
 
 /* names of every sequence */
-struct nname sequence_names[NSEQUENCES+1] = {
+struct nname default_sequence_names[NSEQUENCES+1] = {
 	NNAME_INIT1(1, "First"),
 	NNAME_INIT1(2, "Second"),
 	NNAME_INIT1(3, "Third"),
@@ -94,6 +94,40 @@ struct nname sequence_names[NSEQUENCES+1] = {
 };
 
 
+/*
+ * Duplicate the table of names $names without the national names,
+ * for a new context.
+ */
+struct nname *
+nnames_dup(const struct nname *names)
+{
+	struct nname *dup;
+	size_t n;
+
+	for (n = 0; names[n].name != NULL; n++)
+		;
+	dup = xcalloc(n + 1, sizeof(*dup));  /* with the terminator */
+	for (size_t i = 0; i < n; i++) {
+		dup[i].value = names[i].value;
+		dup[i].name = names[i].name;
+		dup[i].len = names[i].len;
+		dup[i].f_name = names[i].f_name;
+		dup[i].f_len = names[i].f_len;
+	}
+
+	return dup;
+}
+
+void
+nnames_free(struct nname *names)
+{
+	for (size_t i = 0; names[i].name != NULL; i++) {
+		free(names[i].n_name);
+		free(names[i].fn_name);
+	}
+	free(names);
+}
+
 void
 set_nnames(void)
 {
@@ -103,7 +137,7 @@ set_nnames(void)
 
 	memset(&tm, 0, sizeof(tm));
 	for (int i = 0; i < NDOWS; i++) {
-		nname = &dow_names[i];
+		nname = &cal_ctx->dow_names[i];
 		tm.tm_wday = i;
 
 		strftime(buf, sizeof(buf), "%a", &tm);
@@ -123,7 +157,7 @@ set_nnames(void)
 
 	memset(&tm, 0, sizeof(tm));
 	for (int i = 0; i < NMONTHS; i++) {
-		nname = &month_names[i];
+		nname = &cal_ctx->month_names[i];
 		tm.tm_mon = i;
 
 		strftime(buf, sizeof(buf), "%b", &tm);
@@ -160,7 +194,7 @@ set_nsequences(const char *seq)
 			p++;
 
 		len = (size_t)(p - seq);
-		nname = &sequence_names[i];
+		nname = &cal_ctx->sequence_names[i];
 		free(nname->n_name);
 		nname->n_name = xcalloc(1, len + 1);
 		strncpy(nname->n_name, seq, len);
@@ -52,10 +52,13 @@ struct nname {
 	size_t		 fn_len;	/* length of full national name */
 };
 
-extern struct nname dow_names[];	/* names of every day of week */
-extern struct nname month_names[];	/* names of every month */
-extern struct nname sequence_names[];	/* names of every sequence */
+/* names of the default context; see 'struct cal_context' */
+extern struct nname default_dow_names[];
+extern struct nname default_month_names[];
+extern struct nname default_sequence_names[];
 
+struct nname *nnames_dup(const struct nname *names);
+void	nnames_free(struct nname *names);
 void	set_nnames(void);
 void	set_nsequences(const char *seq);
 
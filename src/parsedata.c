@@ -131,7 +131,7 @@ static void	 show_dateinfo(struct dateinfo *di);
 static bool
 determine_style(const char *date, struct dateinfo *di)
 {
-	static char date2[128];
+	static __thread char date2[128];
 	struct specialday *sday;
 	char *p, *p1, *p2;
 	size_t len;
@@ -140,8 +140,8 @@ determine_style(const char *date, struct dateinfo *di)
 
 	if ((p = strchr(date2, ' ')) == NULL &&
 	    (p = strchr(date2, '/')) == NULL) {
-		for (size_t i = 0; specialdays[i].id != SD_NONE; i++) {
-			sday = &specialdays[i];
+		for (size_t i = 0; cal_ctx->specialdays[i].id != SD_NONE; i++) {
+			sday = &cal_ctx->specialdays[i];
 			if (strncasecmp(date2, sday->name, sday->len) == 0) {
 				len = sday->len;
 			} else if (sday->n_len > 0 && strncasecmp(
@@ -297,8 +297,8 @@ show_dateinfo(struct dateinfo *di)
 
 	if ((di->flags & F_SPECIALDAY) != 0) {
 		fprintf(stderr, " specialday");
-		for (size_t i = 0; specialdays[i].id != SD_NONE; i++) {
-			sday = &specialdays[i];
+		for (size_t i = 0; cal_ctx->specialdays[i].id != SD_NONE; i++) {
+			sday = &cal_ctx->specialdays[i];
 			if (di->sday_id == sday->id)
 				fprintf(stderr, "(%s)", sday->name);
 		}
@@ -388,8 +388,8 @@ parse_cal_date(const char *date, int *flags, struct cal_day **dayp, char **edp)
 
 	/* Special days with optional offset (e.g., 'ChineseNewYear+14') */
 	if ((di.flags & F_SPECIALDAY) != 0) {
-		for (size_t i = 0; specialdays[i].id != SD_NONE; i++) {
-			sday = &specialdays[i];
+		for (size_t i = 0; cal_ctx->specialdays[i].id != SD_NONE; i++) {
+			sday = &cal_ctx->specialdays[i];
 			if (di.sday_id == sday->id && sday->find_days != NULL)
 				return (sday->find_days)(offset, dayp, edp);
 		}
@@ -408,8 +408,8 @@ check_month(const char *s, size_t *len, int *month)
 {
 	struct nname *nname;
 
-	for (int i = 0; month_names[i].name != NULL; i++) {
-		nname = &month_names[i];
+	for (int i = 0; cal_ctx->month_names[i].name != NULL; i++) {
+		nname = &cal_ctx->month_names[i];
 
 		if (nname->fn_name &&
 		    strncasecmp(s, nname->fn_name, nname->fn_len) == 0) {
@@ -447,8 +447,8 @@ check_dayofweek(const char *s, size_t *len, int *dow)
 {
 	struct nname *nname;
 
-	for (int i = 0; dow_names[i].name != NULL; i++) {
-		nname = &dow_names[i];
+	for (int i = 0; cal_ctx->dow_names[i].name != NULL; i++) {
+		nname = &cal_ctx->dow_names[i];
 
 		if (nname->fn_name &&
 		    strncasecmp(s, nname->fn_name, nname->fn_len) == 0) {
@@ -513,8 +513,9 @@ parse_index(const char *s, int *index)
 		parsed = true;
 	}
 
-	for (int i = 0; !parsed && sequence_names[i].name != NULL; i++) {
-		nname = &sequence_names[i];
+	for (int i = 0; !parsed && cal_ctx->sequence_names[i].name != NULL;
+	     i++) {
+		nname = &cal_ctx->sequence_names[i];
 		if (strcasecmp(s, nname->name) == 0 ||
 		    (nname->n_name && strcasecmp(s, nname->n_name) == 0)) {
 			*index = nname->value;
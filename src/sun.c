@@ -39,10 +39,14 @@
  * 2018, Cambridge University Press
  */
 
+#include <err.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "basics.h"
 #include "gregorian.h"
@@ -148,7 +152,7 @@ static const struct solar_longitude_arg {
  * Ref: Sec.(14.4), Eq.(14.33)
  */
 double
-solar_longitude(double t)
+solar_longitude_exact(double t)
 {
 	double c = julian_centuries(t);
 
@@ -167,6 +171,22 @@ solar_longitude(double t)
 	return mod_f(lambda + ab + nu, 360);
 }
 
+/*
+ * Calculate the longitude of Sun (in degrees) at moment $t with the
+ * piecewise Chebyshev approximation of 'solar_longitude_exact()'.
+ * The approximation error is below 1e-7 degree.
+ */
+double
+solar_longitude(double t)
+{
+	static __thread struct angular_approx approx = {
+		.func = solar_longitude_exact,
+		.nsegments = 12,
+		.nnodes = 11,
+	};
+	return angular_approx_eval(&approx, t);
+}
+
 /*
  * Calculate the moment (in universal time) of the first time at or after
  * the given moment $t when the solar longitude will be $lambda degree.
@@ -227,6 +247,92 @@ solar_altitude(double t, double latitude, double longitude)
 	return mod3_f(arcsin_deg(v), -180, 180);
 }
 
+/*
+ * Solar quantities sampled hourly over a time span, which are shared by
+ * the rise/set calculations of many locations and days.  The table is
+ * read-only once built, so it can be used by multiple threads.
+ */
+struct solar_table {
+	double	t_begin;	/* universal time of the first sample */
+	int	n;		/* number of samples */
+	double	*declination;
+	double	*eot;		/* equation of time */
+};
+
+/* interval (in days) between the samples of the solar table */
+#define SOLAR_TABLE_STEP	(1.0 / 24.0)
+
+static void
+solar_table_init(struct solar_table *tbl, double t_begin, double t_end)
+{
+	double t, lambda;
+
+	tbl->t_begin = t_begin;
+	tbl->n = (int)ceil((t_end - t_begin) / SOLAR_TABLE_STEP) + 1;
+	tbl->declination = xcalloc((size_t)tbl->n, sizeof(double));
+	tbl->eot = xcalloc((size_t)tbl->n, sizeof(double));
+	for (int i = 0; i < tbl->n; i++) {
+		t = t_begin + i * SOLAR_TABLE_STEP;
+		lambda = solar_longitude(t);
+		tbl->declination[i] = declination(t, 0, lambda);
+		tbl->eot[i] = equation_of_time(t);
+	}
+}
+
+static void
+solar_table_free(struct solar_table *tbl)
+{
+	free(tbl->declination);
+	free(tbl->eot);
+}
+
+/*
+ * Linearly interpolate the sampled values $v of the table $tbl at
+ * moment $t (universal time).
+ */
+static double
+solar_table_interp(const struct solar_table *tbl, const double *v, double t)
+{
+	double x = (t - tbl->t_begin) / SOLAR_TABLE_STEP;
+	int i = (int)floor(x);
+
+	if (i < 0)
+		i = 0;
+	else if (i > tbl->n - 2)
+		i = tbl->n - 2;
+	x -= i;
+	return v[i] + (v[i+1] - v[i]) * x;
+}
+
+/*
+ * Declination of Sun at moment $t (universal time), interpolated from
+ * the table $tbl if given.
+ */
+static double
+solar_declination(const struct solar_table *tbl, double t)
+{
+	if (tbl != NULL)
+		return solar_table_interp(tbl, tbl->declination, t);
+	else
+		return declination(t, 0, solar_longitude(t));
+}
+
+/*
+ * Convert from apparent time $t to local time at $longitude, with the
+ * equation of time interpolated from the table $tbl if given.
+ */
+static double
+solar_local_from_apparent(const struct solar_table *tbl, double t,
+			  double longitude)
+{
+	if (tbl != NULL) {
+		double ut = t - longitude / 360.0;
+		return t - solar_table_interp(tbl, tbl->eot, ut);
+	} else {
+		return local_from_apparent(t, longitude);
+	}
+}
+
 /*
  * Calculate the sine of angle between positions of Sun at local time $t
  * and when its depression angle is $alpha degrees at location ($latitude,
@@ -234,11 +340,11 @@ solar_altitude(double t, double latitude, double longitude)
  * Ref: Sec.(14.7), Eq.(14.69)
  */
 static double
-sine_offset(double t, double latitude, double longitude, double alpha)
+sine_offset(const struct solar_table *tbl, double t, double latitude,
+	    double longitude, double alpha)
 {
 	double ut = t - longitude / 360.0;  /* local -> universal time */
-	double lambda = solar_longitude(ut);
-	double delta = declination(ut, 0, lambda);
+	double delta = solar_declination(tbl, ut);
 
 	return (tan_deg(latitude) * tan_deg(delta) +
 		sin_deg(alpha) / cos_deg(delta) / cos_deg(latitude));
@@ -248,12 +354,14 @@ sine_offset(double t, double latitude, double longitude, double alpha)
  * Approximate the moment in local time near the given moment $t when
  * the depression angle of Sun is $alpha (negative if above horizon) at
  * location ($latitude, $longitude).  If $morning is true, then searching
- * for the morning event; otherwise for the evening event.
+ * for the morning event; otherwise for the evening event.  The solar
+ * quantities are taken from the table $tbl if given.
  * NOTE: Return an NaN if the depression angle cannot be reached.
  * Ref: Sec.(14.7), Eq.(14.68)
  */
 static double
-approx_depression_moment(double t, double latitude, double longitude,
+approx_depression_moment(const struct solar_table *tbl, double t,
+			 double latitude, double longitude,
 			 double alpha, bool morning)
 {
 	double t2 = floor(t);  /* midnight */
@@ -262,9 +370,9 @@ approx_depression_moment(double t, double latitude, double longitude,
 	else if (morning == false)
 		t2 += 1.0;  /* next day */
 
-	double try = sine_offset(t, latitude, longitude, alpha);
+	double try = sine_offset(tbl, t, latitude, longitude, alpha);
 	double value = ((fabs(try) > 1) ?
-			sine_offset(t2, latitude, longitude, alpha) :
+			sine_offset(tbl, t2, latitude, longitude, alpha) :
 			try);
 
 	if (fabs(value) > 1) {
@@ -276,7 +384,7 @@ approx_depression_moment(double t, double latitude, double longitude,
 			t3 += 6.0/24.0 - offset;
 		else
 			t3 += 18.0/24.0 + offset;
-		return local_from_apparent(t3, longitude);
+		return solar_local_from_apparent(tbl, t3, longitude);
 	}
 }
 
@@ -289,18 +397,18 @@ approx_depression_moment(double t, double latitude, double longitude,
  * Ref: Sec.(14.7), Eq.(14.70)
  */
 static double
-depression_moment(double tapprox, double latitude, double longitude,
-		  double alpha, bool morning)
+depression_moment(const struct solar_table *tbl, double tapprox,
+		  double latitude, double longitude, double alpha, bool morning)
 {
 	const double eps = 30.0 / 3600 / 24;  /* accuracy of 30 seconds */
-	double t = approx_depression_moment(tapprox, latitude, longitude,
+	double t = approx_depression_moment(tbl, tapprox, latitude, longitude,
 					    alpha, morning);
 	if (isnan(t))
 		return NAN;
 	else if (fabs(t - tapprox) < eps)
 		return t;
 	else
-		return depression_moment(t, latitude, longitude,
+		return depression_moment(tbl, t, latitude, longitude,
 					 alpha, morning);
 }
 
@@ -316,8 +424,8 @@ sunrise(int rd, const struct location *loc)
 	double sun_radius = 16.0 / 60.0;  /* 16 arcminutes */
 	double alpha = refraction(loc->elevation) + sun_radius;
 	double tapprox = (double)rd + (6.0/24.0);
-	double lt = depression_moment(tapprox, loc->latitude, loc->longitude,
-				      alpha, true);
+	double lt = depression_moment(NULL, tapprox, loc->latitude,
+				      loc->longitude, alpha, true);
 	if (isnan(lt))
 		return NAN;
 	else
@@ -336,14 +444,142 @@ sunset(int rd, const struct location *loc)
 	double sun_radius = 16.0 / 60.0;  /* 16 arcminutes */
 	double alpha = refraction(loc->elevation) + sun_radius;
 	double tapprox = (double)rd + (18.0/24.0);
-	double lt = depression_moment(tapprox, loc->latitude, loc->longitude,
-				      alpha, false);
+	double lt = depression_moment(NULL, tapprox, loc->latitude,
+				      loc->longitude, alpha, false);
 	if (isnan(lt))
 		return NAN;
 	else
 		return lt - loc->longitude / 360.0 + loc->zone;
 }
 
+/* depression angles of Sun at civil, nautical and astronomical twilight */
+static const double twilight_angles[TWILIGHT_NUM] = { 6.0, 12.0, 18.0 };
+
+/*
+ * Calculate the sunrise, sunset and twilight moments in standard time on
+ * fixed date $rd at location $loc, with the solar quantities taken from
+ * the table $tbl.
+ * Ref: Sec.(14.7), Eq.(14.71,14.73)
+ */
+static void
+solar_day_calc(const struct solar_table *tbl, int rd,
+	       const struct location *loc, struct solar_day *sd)
+{
+	double sun_radius = 16.0 / 60.0;  /* 16 arcminutes */
+	double alpha = refraction(loc->elevation) + sun_radius;
+	double offset = loc->zone - loc->longitude / 360.0;
+	double lt;
+
+	lt = depression_moment(tbl, rd + 6.0/24.0, loc->latitude,
+			       loc->longitude, alpha, true);
+	sd->sunrise = lt + offset;
+	lt = depression_moment(tbl, rd + 18.0/24.0, loc->latitude,
+			       loc->longitude, alpha, false);
+	sd->sunset = lt + offset;
+
+	for (int i = 0; i < TWILIGHT_NUM; i++) {
+		lt = depression_moment(tbl, rd + 6.0/24.0, loc->latitude,
+				       loc->longitude, twilight_angles[i],
+				       true);
+		sd->dawn[i] = lt + offset;
+		lt = depression_moment(tbl, rd + 18.0/24.0, loc->latitude,
+				       loc->longitude, twilight_angles[i],
+				       false);
+		sd->dusk[i] = lt + offset;
+	}
+}
+
+struct solar_days_job {
+	const struct solar_table *tbl;
+	int			rd_begin;
+	int			ndays;
+	const struct location	*locs;
+	int			nlocs;
+	struct solar_day	*results;
+	int			first;	/* first work item of this thread */
+	int			stride;	/* number of threads */
+};
+
+static void *
+solar_days_worker(void *arg)
+{
+	const struct solar_days_job *job = arg;
+	int n = job->ndays * job->nlocs;
+	int iloc, iday;
+
+	for (int k = job->first; k < n; k += job->stride) {
+		iloc = k / job->ndays;
+		iday = k % job->ndays;
+		solar_day_calc(job->tbl, job->rd_begin + iday,
+			       &job->locs[iloc], &job->results[k]);
+	}
+
+	return NULL;
+}
+
+/*
+ * Calculate the sunrise, sunset and twilight moments (in standard time)
+ * for $ndays days starting from fixed date $rd_begin at each of the
+ * $nlocs locations $locs.  The results are stored into $results, which
+ * must have room for ($nlocs * $ndays) items, ordered by location and
+ * then by day.
+ *
+ * The solar declination and equation of time are sampled once for the
+ * whole date range and shared by all locations, and the grid is divided
+ * among multiple threads.
+ */
+void
+solar_days(int rd_begin, int ndays, const struct location *locs, int nlocs,
+	   struct solar_day *results)
+{
+	struct solar_table tbl;
+	struct solar_days_job *jobs;
+	pthread_t *threads;
+	long ncpu;
+	int nthreads, n;
+
+	n = ndays * nlocs;
+	if (n <= 0)
+		return;
+
+	/* local times of the searches are within the days; add margins */
+	solar_table_init(&tbl, rd_begin - 1.0, rd_begin + ndays + 2.0);
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nthreads = (ncpu > 1) ? (int)ncpu : 1;
+	if (nthreads > n)
+		nthreads = n;
+
+	jobs = xcalloc((size_t)nthreads, sizeof(*jobs));
+	threads = xcalloc((size_t)nthreads, sizeof(*threads));
+	for (int i = 0; i < nthreads; i++) {
+		jobs[i] = (struct solar_days_job){
+			.tbl = &tbl,
+			.rd_begin = rd_begin,
+			.ndays = ndays,
+			.locs = locs,
+			.nlocs = nlocs,
+			.results = results,
+			.first = i,
+			.stride = nthreads,
+		};
+		if (i == 0)
+			continue;  /* run by the calling thread */
+		if (pthread_create(&threads[i], NULL, solar_days_worker,
+				   &jobs[i]) != 0) {
+			errx(1, "%s: pthread_create() failed", __func__);
+		}
+	}
+
+	solar_days_worker(&jobs[0]);
+	for (int i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(jobs);
+	solar_table_free(&tbl);
+}
+
 /**************************************************************************/
 
 /* Equinoxes and solstices */
@@ -413,3 +649,58 @@ show_sun_info(double t, const struct location *loc)
 		       date.year, date.month, date.day, buf);
 	}
 }
+
+/*
+ * Print the sunrise, sunset and twilight times of the days from $rd_begin
+ * to $rd_end (inclusive) at each of the $nlocs locations $locs.
+ */
+void
+show_twilight_info(int rd_begin, int rd_end, const struct location *locs,
+		   int nlocs)
+{
+	struct solar_day *results, *sd;
+	struct date date;
+	char buf[64];
+	int ndays = rd_end - rd_begin + 1;
+
+	if (ndays <= 0 || nlocs <= 0)
+		return;
+
+	results = xcalloc((size_t)(ndays * nlocs), sizeof(*results));
+	solar_days(rd_begin, ndays, locs, nlocs, results);
+
+	for (int i = 0; i < nlocs; i++) {
+		format_location(buf, sizeof(buf), &locs[i]);
+		printf("%sLocation: %s\n", (i > 0) ? "\n" : "", buf);
+		printf("%-10s  %8s  %8s  %8s  %8s  %8s  %8s  %8s  %8s\n",
+		       "Date", "Astro", "Nautical", "Civil", "Sunrise",
+		       "Sunset", "Civil", "Nautical", "Astro");
+
+		for (int j = 0; j < ndays; j++) {
+			sd = &results[i * ndays + j];
+			double moments[] = {
+				sd->dawn[TWILIGHT_ASTRONOMICAL],
+				sd->dawn[TWILIGHT_NAUTICAL],
+				sd->dawn[TWILIGHT_CIVIL],
+				sd->sunrise,
+				sd->sunset,
+				sd->dusk[TWILIGHT_CIVIL],
+				sd->dusk[TWILIGHT_NAUTICAL],
+				sd->dusk[TWILIGHT_ASTRONOMICAL],
+			};
+
+			gregorian_from_fixed(rd_begin + j, &date);
+			printf("%d-%02d-%02d", date.year, date.month, date.day);
+			for (size_t k = 0; k < nitems(moments); k++) {
+				if (isnan(moments[k]))
+					snprintf(buf, sizeof(buf), "(null)");
+				else
+					format_time(buf, sizeof(buf), moments[k]);
+				printf("  %8s", buf);
+			}
+			printf("\n");
+		}
+	}
+
+	free(results);
+}
@@ -46,13 +46,33 @@ double	nutation(double t);
 
 double	estimate_prior_solar_longitude(double lambda, double t);
 double	solar_longitude(double t);
+double	solar_longitude_exact(double t);
 double	solar_longitude_atafter(double lambda, double t);
 
 double	solar_altitude(double t, double latitude, double longitude);
 
+enum twilight {
+	TWILIGHT_CIVIL,
+	TWILIGHT_NAUTICAL,
+	TWILIGHT_ASTRONOMICAL,
+	TWILIGHT_NUM,
+};
+
+/* moments in standard time; NaN if not happen */
+struct solar_day {
+	double	sunrise;
+	double	sunset;
+	double	dawn[TWILIGHT_NUM];
+	double	dusk[TWILIGHT_NUM];
+};
+
 double	sunrise(int rd, const struct location *loc);
 double	sunset(int rd, const struct location *loc);
+void	solar_days(int rd_begin, int ndays, const struct location *locs,
+		   int nlocs, struct solar_day *results);
 
 void	show_sun_info(double t, const struct location *loc);
+void	show_twilight_info(int rd_begin, int rd_end,
+			   const struct location *locs, int nlocs);
 
 #endif
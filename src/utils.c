@@ -70,8 +70,8 @@ poly(double x, const double *coefs, size_t n)
  * $f(x) at value $y (degrees) within time interval [$a, $b].
  * Ref: Sec.(1.8), Eq.(1.36)
  */
-double
-invert_angular(double (*f)(double), double y, double a, double b)
+static double
+invert_angular_bisect(double (*f)(double), double y, double a, double b)
 {
 	static const double eps = 1e-6;
 	double x;
@@ -87,6 +87,109 @@ invert_angular(double (*f)(double), double y, double a, double b)
 	return x;
 }
 
+/*
+ * Find the inverse of the given angular function $f(x) at value $y
+ * (degrees) within time interval [$a, $b].
+ *
+ * Use the regula falsi with the Illinois modification, which keeps the
+ * root bracketed like the bisection search but converges superlinearly
+ * for the smooth solar longitude and lunar phase functions.  Fall back
+ * to the bisection search if the root is not bracketed.
+ */
+double
+invert_angular(double (*f)(double), double y, double a, double b)
+{
+	static const double eps = 1e-6;
+	static const int max_iter = 100;
+	double fa = mod3_f(f(a) - y, -180, 180);
+	double fb = mod3_f(f(b) - y, -180, 180);
+	double x = a, x_prev, fx;
+	int side = 0;
+
+	if (fa >= 0.0 || fb < 0.0)
+		return invert_angular_bisect(f, y, a, b);
+
+	for (int i = 0; i < max_iter; i++) {
+		x_prev = x;
+		x = (a * fb - b * fa) / (fb - fa);
+		fx = mod3_f(f(x) - y, -180, 180);
+		if (fx >= 0.0) {
+			b = x;
+			fb = fx;
+			if (side == 1)
+				fa /= 2.0;
+			side = 1;
+		} else {
+			a = x;
+			fa = fx;
+			if (side == -1)
+				fb /= 2.0;
+			side = -1;
+		}
+
+		if (fabs(x - x_prev) < eps || b - a < eps)
+			return x;
+	}
+
+	return invert_angular_bisect(f, y, a, b);
+}
+
+/*
+ * Fit the angular function $f(x) (degrees) over the interval [$a, $b)
+ * with $n Chebyshev nodes.  The function values are unwrapped across
+ * the 0/360 degree boundary, so the function must change by less than
+ * 180 degrees between two adjacent nodes.
+ */
+void
+chebyshev_fit_angular(struct chebyshev *cb, double (*f)(double),
+		      double a, double b, int n)
+{
+	double fx[CHEBYSHEV_NMAX];
+	double mid = (a + b) / 2.0;
+	double half = (b - a) / 2.0;
+	double s;
+
+	if (n < 1 || n > CHEBYSHEV_NMAX)
+		errx(1, "%s: invalid number of nodes: %d", __func__, n);
+
+	for (int k = 0; k < n; k++) {
+		fx[k] = f(mid + half * cos(M_PI * (k + 0.5) / n));
+		if (k > 0)
+			fx[k] = fx[k-1] + mod3_f(fx[k] - fx[k-1], -180, 180);
+	}
+
+	for (int j = 0; j < n; j++) {
+		s = 0.0;
+		for (int k = 0; k < n; k++)
+			s += fx[k] * cos(M_PI * j * (k + 0.5) / n);
+		cb->coefs[j] = 2.0 * s / n;
+	}
+	cb->coefs[0] /= 2.0;
+
+	cb->a = a;
+	cb->b = b;
+	cb->n = n;
+}
+
+/*
+ * Evaluate the Chebyshev approximation $cb at $x with the Clenshaw
+ * recurrence.
+ */
+double
+chebyshev_eval(const struct chebyshev *cb, double x)
+{
+	double u = (2.0 * x - cb->a - cb->b) / (cb->b - cb->a);
+	double b0 = 0.0, b1 = 0.0, b2;
+
+	for (int j = cb->n - 1; j >= 1; j--) {
+		b2 = b1;
+		b1 = b0;
+		b0 = 2.0 * u * b1 - b2 + cb->coefs[j];
+	}
+
+	return u * b0 - b1 + cb->coefs[0];
+}
+
 
 /*
  * Like malloc(3) but exit if allocation fails.
@@ -192,6 +295,17 @@ list_lookup(struct node *listp, const char *name,
 	return false;
 }
 
+/*
+ * Call $fn with the name and data of each node of list $listp, in order.
+ */
+void
+list_foreach(struct node *listp,
+	     void (*fn)(const char *name, void *data, void *arg), void *arg)
+{
+	for ( ; listp; listp = listp->next)
+		(*fn)(listp->name, listp->data, arg);
+}
+
 /*
  * Free all nodes of list $listp.
  */
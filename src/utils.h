@@ -250,10 +250,27 @@ angle2deg(int deg, int min, double sec)
 	return deg + min/60.0 + sec/3600.0;
 }
 
+/* maximum number of nodes of a Chebyshev approximation */
+#define CHEBYSHEV_NMAX	16
+
+/*
+ * Chebyshev approximation of a function over the interval [a, b).
+ */
+struct chebyshev {
+	double	a;
+	double	b;
+	int	n;
+	double	coefs[CHEBYSHEV_NMAX];
+};
+
 
 double	poly(double x, const double *coefs, size_t n);
 double	invert_angular(double (*f)(double), double y, double a, double b);
 
+void	chebyshev_fit_angular(struct chebyshev *cb, double (*f)(double),
+			      double a, double b, int n);
+double	chebyshev_eval(const struct chebyshev *cb, double x);
+
 void *	xmalloc(size_t size);
 void *	xcalloc(size_t number, size_t size);
 void *	xrealloc(void *ptr, size_t size);
@@ -265,6 +282,10 @@ struct node *	list_addfront(struct node *listp, struct node *newp);
 bool		list_lookup(struct node *listp, const char *name,
 			    int (*cmp)(const char *, const char *),
 			    void **data_out);
+void		list_foreach(struct node *listp,
+			     void (*fn)(const char *name, void *data,
+					void *arg),
+			     void *arg);
 void		list_freeall(struct node *listp, void (*free_name)(void *),
 			     void (*free_data)(void *));
 
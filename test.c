@@ -22,8 +22,6 @@
  * globals
  * for compatible with calendar.c ... files
  */
-struct cal_options Options;
-struct calendar *Calendar;
 const char *calendarDirs[] = { NULL };
 
 bool set_calendar(const char *name __unused) { return true; }
@@ -101,6 +99,21 @@ test1(void)
 				rd, ephemeris, eot, solar_lon, next_se, lambda);
 	}
 
+	/* Chebyshev approximations vs. the exact series in 1800-2199 */
+	double err_sun = 0.0, err_moon = 0.0, err;
+	for (t = 657072.0; t < 803169.0; t += 1.37) {
+		err = fabs(mod3_f(solar_longitude(t) -
+				  solar_longitude_exact(t), -180, 180));
+		if (err > err_sun)
+			err_sun = err;
+		err = fabs(mod3_f(lunar_longitude(t) -
+				  lunar_longitude_exact(t), -180, 180));
+		if (err > err_moon)
+			err_moon = err;
+	}
+	printf("\nApproximation max error: solar %.3g°, lunar %.3g°\n",
+			err_sun, err_moon);
+
 	/* Location of Jerusalem (Eq. 14.4) */
 	const struct location jerusalem = {
 		.latitude = 31.78,
@@ -117,6 +130,17 @@ test1(void)
 		printf("%7d\t%.8lf\t\t%s\n", rd, t_sunset, buf);
 	}
 
+	struct solar_day sd;
+	printf("\nR.D.\tSunrise[Jerusalem]\tBatch\t\tCivilDawn\n");
+	for (size_t i = 0; i < nitems(rds); i++) {
+		rd = rds[i];
+		solar_days(rd, 1, &jerusalem, 1, &sd);
+		printf("%7d\t%.8lf\t\t%.8lf\t%.8lf\n", rd,
+				sunrise(rd, &jerusalem) - (double)rd,
+				sd.sunrise - (double)rd,
+				sd.dawn[TWILIGHT_CIVIL] - (double)rd);
+	}
+
 	/* Location of Mecca (Eq. 14.3) */
 	const struct location mecca = {
 		.latitude = angle2deg(21, 25, 24),
@@ -320,6 +344,174 @@ test3()
 }
 
 
+/*
+ * Textbook conversions of Calendrical Calculations, as the reference of
+ * the conversions in gregorian.c and julian.c.
+ */
+static bool
+ref_gregorian_leap_year(int year)
+{
+	int r4 = mod(year, 4);
+	int r400 = mod(year, 400);
+	return (r4 == 0 && (r400 != 100 && r400 != 200 && r400 != 300));
+}
+
+static int
+ref_fixed_from_gregorian(const struct date *date)
+{
+	int rd = (365 * (date->year - 1) +
+		  div_floor(date->year - 1, 4) -
+		  div_floor(date->year - 1, 100) +
+		  div_floor(date->year - 1, 400) +
+		  div_floor(date->month * 367 - 362, 12));
+	if (date->month <= 2)
+		return rd + date->day;
+	else if (ref_gregorian_leap_year(date->year))
+		return rd + date->day - 1;
+	else
+		return rd + date->day - 2;
+}
+
+static int
+ref_gregorian_year_from_fixed(int rd)
+{
+	int d0 = rd - 1;
+	int d1 = mod(d0, 146097);
+	int d2 = mod(d1, 36524);
+	int d3 = mod(d2, 1461);
+	int n100 = div_floor(d1, 36524);
+	int n1 = div_floor(d3, 365);
+	int year = (400 * div_floor(d0, 146097) + 100 * n100 +
+		    4 * div_floor(d2, 1461) + n1);
+	return (n100 == 4 || n1 == 4) ? year : year + 1;
+}
+
+static void
+ref_gregorian_from_fixed(int rd, struct date *date)
+{
+	int correction, pdays;
+
+	date->year = ref_gregorian_year_from_fixed(rd);
+	struct date d = { date->year, 3, 1 };
+	if (rd < ref_fixed_from_gregorian(&d))
+		correction = 0;
+	else if (ref_gregorian_leap_year(date->year))
+		correction = 1;
+	else
+		correction = 2;
+	d.month = 1;
+	pdays = rd - ref_fixed_from_gregorian(&d);
+	date->month = div_floor(12 * (pdays + correction) + 373, 367);
+	d.month = date->month;
+	date->day = rd - ref_fixed_from_gregorian(&d) + 1;
+}
+
+static int
+ref_fixed_from_julian(const struct date *date)
+{
+	int y = (date->year >= 0) ? date->year : (date->year + 1);
+	int rd = (-2 + 365 * (y - 1) + div_floor(y - 1, 4) +
+		  div_floor(date->month * 367 - 362, 12));
+	if (date->month <= 2)
+		return rd + date->day;
+	else if (julian_leap_year(date->year))
+		return rd + date->day - 1;
+	else
+		return rd + date->day - 2;
+}
+
+static void
+ref_julian_from_fixed(int rd, struct date *date)
+{
+	int correction, pdays;
+
+	date->year = div_floor(4 * (rd + 1) + 1464, 1461);
+	if (date->year <= 0)
+		date->year--;
+	struct date d = { date->year, 3, 1 };
+	if (rd < ref_fixed_from_julian(&d))
+		correction = 0;
+	else if (julian_leap_year(date->year))
+		correction = 1;
+	else
+		correction = 2;
+	d.month = 1;
+	pdays = rd - ref_fixed_from_julian(&d);
+	date->month = div_floor(12 * (pdays + correction) + 373, 367);
+	d.month = date->month;
+	date->day = rd - ref_fixed_from_julian(&d) + 1;
+}
+
+static bool
+date_equal(const struct date *d1, const struct date *d2)
+{
+	return (d1->year == d2->year && d1->month == d2->month &&
+		d1->day == d2->day);
+}
+
+/*
+ * Check the Gregorian and Julian conversions of the fixed date $rd
+ * against the reference implementations.
+ */
+static void
+check_conversions(int rd, int *g_errors, int *j_errors)
+{
+	struct date date, ref;
+
+	gregorian_from_fixed(rd, &date);
+	ref_gregorian_from_fixed(rd, &ref);
+	if (!date_equal(&date, &ref) ||
+	    gregorian_year_from_fixed(rd) != ref.year ||
+	    fixed_from_gregorian(&ref) != rd ||
+	    gregorian_leap_year(ref.year) !=
+	    ref_gregorian_leap_year(ref.year)) {
+		if ((*g_errors)++ < 10)
+			printf("Gregorian mismatch: %d\n", rd);
+	}
+
+	julian_from_fixed(rd, &date);
+	ref_julian_from_fixed(rd, &ref);
+	if (!date_equal(&date, &ref) ||
+	    fixed_from_julian(&ref) != rd) {
+		if ((*j_errors)++ < 10)
+			printf("Julian mismatch: %d\n", rd);
+	}
+}
+
+static void
+test4(void)
+{
+	const int range = 1000000;
+	const int far_range = 500000000;  /* supported range of SHIFT_CYCLES */
+	const int far_step = 997;
+	int ndays = 0, g_errors = 0, j_errors = 0;
+
+	printf("\n-----------------------------------------------------------\n");
+
+	for (int rd = -range; rd <= range; rd++) {
+		ndays++;
+		check_conversions(rd, &g_errors, &j_errors);
+	}
+
+	printf("Days checked: %d\n", ndays);
+	printf("Gregorian mismatches: %d\n", g_errors);
+	printf("Julian mismatches: %d\n", j_errors);
+
+	/* sample the days up to the limits */
+	ndays = g_errors = j_errors = 0;
+	for (int rd = -far_range; rd < far_range; rd += far_step) {
+		ndays++;
+		check_conversions(rd, &g_errors, &j_errors);
+	}
+	ndays++;
+	check_conversions(far_range, &g_errors, &j_errors);
+
+	printf("Days sampled within ±%d: %d\n", far_range, ndays);
+	printf("Gregorian mismatches: %d\n", g_errors);
+	printf("Julian mismatches: %d\n", j_errors);
+}
+
+
 /* Return the seconds east of UTC */
 static int
 get_utcoffset(void)
@@ -383,6 +575,7 @@ main(int argc, char *argv[])
 		test1();
 		test2();
 		test3();
+		test4();
 	}
 
 	return 0;
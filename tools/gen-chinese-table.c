@@ -0,0 +1,104 @@
+/*-
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Copyright (c) 2019-2020 The DragonFly Project.  All rights reserved.
+ *
+ * This code is derived from software contributed to The DragonFly Project
+ * by Aaron LI <aly@aaronly.me>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name of The DragonFly Project nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific, prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Generate the table of Chinese years (src/chinese_table.h) with the
+ * astronomical calculations in src/chinese.c, which must be compiled
+ * with CHINESE_NO_TABLE defined.
+ *
+ * Usage: gen-chinese-table <first-year> <last-year>
+ */
+
+#include <err.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "calendar.h"
+#include "chinese.h"
+
+/* stubs of the globals required by the calendar code */
+const char *calendarDirs[] = { NULL };
+bool set_calendar(const char *name __unused) { return true; }
+
+int
+main(int argc, char *argv[])
+{
+	struct chinese_date cdate;
+	int first, last, year, rd, next, pos, leap, bigmonths;
+
+	if (argc != 3)
+		errx(1, "usage: %s <first-year> <last-year>", argv[0]);
+	first = atoi(argv[1]);
+	last = atoi(argv[2]);
+	if (first > last)
+		errx(1, "invalid year range: %d - %d", first, last);
+
+	printf("/*\n"
+	       " * Chinese years of %d - %d.\n"
+	       " *\n"
+	       " * Generated by tools/gen-chinese-table.c; DO NOT EDIT.\n"
+	       " * Regenerate with 'make -f GNUmakefile chinese-table'.\n"
+	       " */\n\n", first, last);
+	printf("#define CHINESE_TABLE_BEGIN\t%d\n\n", first);
+	printf("static const struct chinese_year chinese_years[] = {\n");
+
+	for (year = first; year <= last; year++) {
+		rd = chinese_new_year(year);
+		next = chinese_new_year(year + 1);
+		leap = bigmonths = 0;
+		for (pos = 1; rd < next; pos++) {
+			chinese_from_fixed(rd, &cdate);
+			if (cdate.leap)
+				leap = pos;
+			chinese_from_fixed(rd + 29, &cdate);
+			if (cdate.day == 1) {
+				rd += 29;
+			} else {
+				bigmonths |= 1 << (pos - 1);
+				rd += 30;
+			}
+		}
+		if (rd != next)
+			errx(1, "inconsistent months in year %d", year);
+
+		printf("\t{ %d, 0x%04x, %2d },  /* %d */\n",
+		       chinese_new_year(year), bigmonths, leap, year);
+	}
+
+	printf("};\n");
+	return 0;
+}